@@ -0,0 +1,63 @@
+# PlatformIO post-build script: reports where the audio render path landed.
+#
+# Lists the lookup tables and DSP functions together with the memory region
+# their address falls into. Anything in the render path that shows up as
+# "flash" is subject to flash cache misses (see src/placement.h).
+
+Import("env")
+
+import os
+import subprocess
+
+# ESP32 address map (see the ESP32 TRM, "System and Memory")
+REGIONS = [
+    (0x3F400000, 0x3FC00000, "flash (rodata)"),
+    (0x3FFAE000, 0x40000000, "DRAM"),
+    (0x40070000, 0x400A0000, "IRAM"),
+    (0x400C2000, 0x40C00000, "flash (code)"),
+]
+
+# symbol name fragments that belong to the render path
+WATCHED = (
+    "lut_", "wav_", "peaks::", "Mixer::", "Reverb::", "Comb<", "Allpass<",
+    "Echo::", "Drummer::",
+)
+
+
+def region(addr):
+    for lo, hi, name in REGIONS:
+        if lo <= addr < hi:
+            return name
+    return "?"
+
+
+def placement_report(source, target, env):
+    elf = str(target[0])
+    nm = env.subst("$CC").replace("gcc", "nm")
+    try:
+        out = subprocess.check_output(
+            [nm, "-C", "-S", "--defined-only", elf],
+            env=env["ENV"], universal_newlines=True)
+    except (OSError, subprocess.CalledProcessError) as e:
+        print("placement report: cannot run %s: %s" % (nm, e))
+        return
+
+    rows = []
+    for line in out.splitlines():
+        parts = line.split(None, 3)
+        if len(parts) != 4:
+            continue
+        addr, size, kind, name = parts
+        if not any(w in name for w in WATCHED):
+            continue
+        rows.append((region(int(addr, 16)), int(size, 16), name))
+
+    print("")
+    print("Render path placement:")
+    for reg, size, name in sorted(rows):
+        print("  %-15s %6d  %s" % (reg, size, name))
+    print("")
+
+
+env.AddPostAction(os.path.join("$BUILD_DIR", "${PROGNAME}.elf"),
+                  placement_report)
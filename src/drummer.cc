@@ -5,8 +5,8 @@
 //i2s configuration
 i2s_config_t i2s_config = {
      .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_TX),
-     .sample_rate = 41100,
-     .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
+     .sample_rate = SAMPLE_RATE,
+     .bits_per_sample = (i2s_bits_per_sample_t)I2S_OUTPUT_BITS,
      .channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT,
      .communication_format = (i2s_comm_format_t)(I2S_COMM_FORMAT_I2S | I2S_COMM_FORMAT_I2S_LSB),
      .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1, // high interrupt priority
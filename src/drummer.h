@@ -1,10 +1,49 @@
 #include <driver/i2s.h>
 
 #include "peaks-drums.h"
+#include "kit.h"
+#include "latency.h"
 #include "mixer.h"
+#include "queue.h"
+#include "snapshot.h"
+#include "velocity.h"
 
 constexpr byte ACCENT_THRESHOLD = 110;
 
+// I2S sample width: 16 or 32. In 32 bit mode the 24 bit mix bus is sent
+// as is (left aligned in the slot), in 16 bit mode it is truncated
+#ifndef I2S_OUTPUT_BITS
+#define I2S_OUTPUT_BITS 32
+#endif
+
+// TPDF dither when truncating the mix bus to 16 bit output
+#ifndef I2S_DITHER
+#define I2S_DITHER 1
+#endif
+
+#if I2S_OUTPUT_BITS == 16
+using i2s_sample_t = int16_t;
+#elif I2S_OUTPUT_BITS == 32
+using i2s_sample_t = int32_t;
+#else
+#error "I2S_OUTPUT_BITS must be 16 or 32"
+#endif
+
+// oversampling of the KickDrum and FmDrum overdrive: 1 (off), 2 or 4
+#ifndef KICK_OVERSAMPLING
+#define KICK_OVERSAMPLING 2
+#endif
+
+#ifndef FM_OVERSAMPLING
+#define FM_OVERSAMPLING 2
+#endif
+
+// voices rendering at once over all parts. A hit beyond the budget steals
+// the voice that started longest ago
+#ifndef LITTLEBEAT_VOICE_BUDGET
+#define LITTLEBEAT_VOICE_BUDGET DrumKit::VOICE_COUNT
+#endif
+
 //i2s configuration
 constexpr int i2s_num = 0; // i2s port number
 extern i2s_config_t i2s_config;
@@ -12,70 +51,80 @@ extern i2s_pin_config_t pin_config;
 
 class Drummer {
 public:
-    // Percussion ID for triggering
-    enum Percussion {
-        BASS_DRUM = 0,
-        KICK_DRUM,
-        SNARE,
-        HIHAT_CLOSED,
-        HIHAT_OPEN,
-        FM,
-        CLAP
+    // engine state for monitoring, published from the audio path
+    struct Status {
+        Mixer::Meters meters;
+        uint16_t load;      // see get_load()
+        uint32_t underruns; // estimated count of I2S DMA underruns
     };
 
+    // kits played at once, see LITTLEBEAT_PARTS
+    static constexpr unsigned PART_COUNT = LITTLEBEAT_PARTS;
+
+    // voices of all parts. Voice v is voice v % DrumKit::VOICE_COUNT of part
+    // v / DrumKit::VOICE_COUNT and plays on mixer channel v
+    static constexpr unsigned VOICE_MAX = Mixer::CHANNEL_MAX;
+
     void init() {
-        bass.Init();
-        kick.Init();
-        snare.Init();
-        high_hat.Init();
-        fm.Init();
-        clap.Init();
+        ConfigureVoice configure;
+        for (unsigned p = 0; p < PART_COUNT; ++p) kits[p].visit(configure);
 
         //initialize i2s with configurations above
         i2s_driver_install((i2s_port_t)i2s_num, &i2s_config, 0, NULL);
         i2s_set_pin((i2s_port_t)i2s_num, &pin_config);
+
+        cycles_per_sample =
+            ESP.getCpuFreqMHz() * 1000000 / i2s_config.sample_rate;
+
+        unsigned dma_frames = i2s_config.dma_buf_count * i2s_config.dma_buf_len;
+        dma_duration = (uint64_t)dma_frames * 1000000 / i2s_config.sample_rate;
+        dma_blocks = dma_frames / Mixer::BLOCK_SIZE;
     }
 
-    void trigger(Percussion percussion, byte velocity) {
-        switch (percussion) {
-        case BASS_DRUM:
-            bass_is_accented = accent(velocity);
-            mixer.set_velocity(Mixer::BASS_DRUM, velocity);
-            bass_trigger = peaks::CONTROL_GATE_RISING;
-            break;
-        case KICK_DRUM:
-            kick_is_accented = accent(velocity);
-            mixer.set_velocity(Mixer::KICK_DRUM, velocity);
-            kick_trigger = peaks::CONTROL_GATE_RISING;
-            break;
-        case SNARE:
-            snare_is_accented = accent(velocity);
-            mixer.set_velocity(Mixer::SNARE, velocity);
-            snare_trigger = peaks::CONTROL_GATE_RISING;
-            break;
-        case HIHAT_CLOSED:
-            high_hat_is_accented = accent(velocity);
-            mixer.set_velocity(Mixer::HI_HAT, velocity);
-            high_hat.set_open(false);
-            high_hat_trigger = peaks::CONTROL_GATE_RISING;
-            break;
-        case HIHAT_OPEN:
-            high_hat_is_accented = accent(velocity);
-            mixer.set_velocity(Mixer::HI_HAT, velocity);
-            high_hat.set_open(true);
-            high_hat_trigger = peaks::CONTROL_GATE_RISING;
-            break;
-        case FM:
-            fm_is_accented = accent(velocity);
-            mixer.set_velocity(Mixer::FM, velocity);
-            fm_trigger = peaks::CONTROL_GATE_RISING;
-            break;
-        case CLAP:
-            clap_is_accented = accent(velocity);
-            mixer.set_velocity(Mixer::CLAP, velocity);
-            clap_trigger = peaks::CONTROL_GATE_RISING;
-            break;
-        }
+    // overrides a parameter of the voice for one hit, see TriggerEvent
+    struct ParamLock {
+        uint8_t param; // voice parameter, below DrumKit::param_count
+        uint16_t value;
+    };
+
+    // parameter locks one hit may carry
+    static constexpr unsigned LOCK_MAX = 4;
+
+    /** a hit of a voice of the kits, see VOICE_MAX. The parameter locks (p-locks) hold for
+        this hit only, the next hit of the voice plays its own values again.
+        Velocity 0 chokes the voice instead */
+    struct TriggerEvent {
+        uint8_t voice;
+        uint8_t variant;
+        uint8_t velocity;
+        uint8_t lock_count;
+        ParamLock locks[LOCK_MAX];
+        uint32_t received; // micros() the MIDI message came in, 0 if none
+    };
+
+    /** queues a hit. It starts with the first sample of the next block,
+        locks included. False if the event queue is full */
+    bool trigger(const TriggerEvent &ev) {
+        return events.push(ev);
+    }
+
+    /** triggers a voice (see DrumKit::index_of, VOICE_MAX). The variant
+        selects a flavour of the voice, i.e. the open hi-hat */
+    bool trigger(unsigned voice, byte velocity, unsigned variant = 0) {
+        if (!velocity) return false;
+        TriggerEvent ev = {};
+        ev.voice = voice;
+        ev.variant = variant;
+        ev.velocity = velocity;
+        return trigger(ev);
+    }
+
+    /** silences a voice. It fades out over the next block and is idle from
+        then on. A trigger in the same block wins over the choke */
+    bool choke(unsigned voice) {
+        TriggerEvent ev = {};
+        ev.voice = voice;
+        return trigger(ev);
     }
 
     bool accent(byte velocity) const {
@@ -88,33 +137,76 @@ public:
 
     /** percussion sound counter. Some are deduplicated (i.e. hihat) */
     unsigned percussion_count() const {
-        return 6;
+        return VOICE_MAX;
     }
 
     /** returns name of the given percussion index */
     const char *percussion_name(unsigned idx) const {
-        switch(idx) {
-        case 0: return "Bass Drum";
-        case 1: return "Kick Drum";
-        case 2: return "Snare Drum";
-        case 3: return "Hi-Hat";
-        case 4: return "FM Drum";
-        case 5: return "Clap";
-        default: return nullptr;
+        return DrumKit::name(idx % DrumKit::VOICE_COUNT);
+    }
+
+    /** part the given percussion index belongs to */
+    unsigned percussion_part(unsigned idx) const {
+        return idx / DrumKit::VOICE_COUNT;
+    }
+
+    /** parameter count of the given percussion index. The voice parameters
+        are followed by those of the drummer, see VoiceParam */
+    unsigned param_count(unsigned idx) const {
+        if (idx >= VOICE_MAX) return 0;
+        return DrumKit::param_count(idx % DrumKit::VOICE_COUNT) + VP_COUNT;
+    }
+
+    const char *param_name(unsigned idx, unsigned param) const {
+        unsigned pc = DrumKit::param_count(idx % DrumKit::VOICE_COUNT);
+        if (param < pc)
+            return DrumKit::param_name(idx % DrumKit::VOICE_COUNT, param);
+
+        switch (param - pc) {
+        case VP_CURVE_SHAPE: return "Vel. Curve";
+        case VP_CURVE_DEPTH: return "Vel. Depth";
+        case VP_CHOKE_GROUP: return "Choke Grp";
+        default: return "?";
         }
     }
 
-    /** returns percussion index */
-    peaks::Configurable *get_percussion(unsigned idx) {
-        switch(idx) {
-        case 0: return &bass;
-        case 1: return &kick;
-        case 2: return &snare;
-        case 3: return &high_hat;
-        case 4: return &fm;
-        case 5: return &clap;
-        default:
-            return nullptr;
+    /** the voice's own value, not a lock of the current hit */
+    uint16_t get_param(unsigned idx, unsigned param) const {
+        if (idx >= VOICE_MAX) return 0;
+
+        unsigned pc = DrumKit::param_count(idx % DrumKit::VOICE_COUNT);
+        if (param < pc) {
+            int slot = lock_slot(idx, param);
+            return slot < 0 ? kit_param(idx, param) : locked[idx][slot].value;
+        }
+
+        switch (param - pc) {
+        case VP_CURVE_SHAPE: return curves[idx].shape;
+        case VP_CURVE_DEPTH: return curves[idx].depth;
+        case VP_CHOKE_GROUP: return choke_groups[idx] * 65535 / CHOKE_GROUPS;
+        default: return 0;
+        }
+    }
+
+    void set_param(unsigned idx, unsigned param, uint16_t value) {
+        if (idx >= VOICE_MAX) return;
+
+        unsigned pc = DrumKit::param_count(idx % DrumKit::VOICE_COUNT);
+        if (param < pc) {
+            // a locked parameter keeps the new value after the hit
+            int slot = lock_slot(idx, param);
+            if (slot >= 0) locked[idx][slot].value = value;
+            set_kit_param(idx, param, value);
+            return;
+        }
+
+        switch (param - pc) {
+        case VP_CURVE_SHAPE: curves[idx].shape = value; break;
+        case VP_CURVE_DEPTH: curves[idx].depth = value; break;
+        case VP_CHOKE_GROUP:
+            // 0 is no group, the range is split evenly between the rest
+            choke_groups[idx] = value * (CHOKE_GROUPS + 1) >> 16;
+            break;
         }
     }
 
@@ -122,63 +214,373 @@ public:
         return mixer;
     }
 
+    /** audio engine load. 65535 means the whole sample period is spent rendering */
+    uint16_t get_load() const {
+        return load;
+    }
+
+    /** latest published engine status. Safe to call outside the audio path */
+    bool get_status(Status &tgt) const {
+        return status.read(tgt);
+    }
+
+    /** us of audio the I2S DMA buffers hold */
+    uint32_t get_dma_duration() const {
+        return dma_duration;
+    }
+
+    /** changes whenever a new status gets published */
+    uint32_t get_status_version() const {
+        return status.version();
+    }
+
+    // kit visitor that readies the voices for rendering, as the drummer
+    // plays them
+    struct ConfigureVoice {
+        void operator()(peaks::KickDrum &kick, unsigned) {
+            kick.Init();
+            kick.set_oversampling(KICK_OVERSAMPLING);
+        }
+
+        void operator()(peaks::FmDrum &fm, unsigned) {
+            fm.Init();
+            fm.set_oversampling(FM_OVERSAMPLING);
+        }
+
+        template<typename Voice>
+        void operator()(Voice &voice, unsigned) {
+            voice.Init();
+        }
+    };
+
 protected:
-    void next_sample(int16_t *left_sample, int16_t *right_sample)
+    /* renders one block of all voices, mixes it and fills out_block */
+    DSP_HOT void render_block()
     {
-        mixer[Mixer::BASS_DRUM] = bass.ProcessSingleSample(bass_trigger);
-        mixer[Mixer::KICK_DRUM] = kick.ProcessSingleSample(kick_trigger);
-        mixer[Mixer::SNARE]     = snare.ProcessSingleSample(snare_trigger);
-        mixer[Mixer::HI_HAT]    = high_hat.ProcessSingleSample(high_hat_trigger);
-        mixer[Mixer::FM]        = fm.ProcessSingleSample(fm_trigger);
-        mixer[Mixer::CLAP]      = clap.ProcessSingleSample(clap_trigger);
-
-        // reset triggers
-        bass_trigger = peaks::CONTROL_GATE;
-        kick_trigger = peaks::CONTROL_GATE;
-        snare_trigger = peaks::CONTROL_GATE;
-        high_hat_trigger = peaks::CONTROL_GATE;
-        fm_trigger = peaks::CONTROL_GATE;
-        clap_trigger = peaks::CONTROL_GATE;
-
-        mixer.mix(left_sample, right_sample);
-    }
-
-    /* write sample data to I2S */
-    bool i2s_write_sample_nb(uint32_t sample) {
-        return i2s_write_bytes((i2s_port_t)i2s_num, &sample, sizeof(uint32_t), 100);
-    }
-
-    int16_t left, right;
-
-    // feed a few samples
-    void feed_i2s() {
-        // 16bit per sample, stereo
-        for (int ctr = 0; ctr < 64; ++ctr) {
-            if (!i2s_write_sample_nb(right << 16 | left)) break;
-            next_sample(&left, &right);
-        }
-    }
-
-    bool bass_is_accented = false;
-    bool kick_is_accented = false;
-    bool snare_is_accented = false;
-    bool high_hat_is_accented = false;
-    bool fm_is_accented = false;
-    bool clap_is_accented = false;
-
-    peaks::ControlBitMask bass_trigger;
-    peaks::ControlBitMask kick_trigger;
-    peaks::ControlBitMask snare_trigger;
-    peaks::ControlBitMask high_hat_trigger;
-    peaks::ControlBitMask fm_trigger;
-    peaks::ControlBitMask clap_trigger;
-
-    peaks::BassDrum bass;
-    peaks::KickDrum kick;
-    peaks::SnareDrum snare;
-    peaks::HighHat high_hat;
-    peaks::FmDrum fm;
-    peaks::Clap clap;
+        uint32_t start = ESP.getCycleCount();
+        PROFILE_FRAMES(Mixer::BLOCK_SIZE);
+
+        TriggerEvent ev;
+        while (events.pop(ev)) start_event(ev);
+
+        {
+            PROFILE_SCOPE(VOICES);
+            RenderVoice render = {*this};
+            for (unsigned p = 0; p < PART_COUNT; ++p)
+                kits[p].visit(render, p * DrumKit::VOICE_COUNT);
+        }
+
+        int32_t mixed[Mixer::BLOCK_SIZE * 2];
+        mixer.mix(mixed);
+        to_i2s(mixed, out_block);
+
+        update_load(ESP.getCycleCount() - start, Mixer::BLOCK_SIZE);
+
+        if (++status_blocks >= STATUS_PERIOD) publish_status();
+    }
+
+    // applies a queued event, right before the block it starts on
+    void start_event(const TriggerEvent &ev) {
+        unsigned voice = ev.voice;
+        if (voice >= VOICE_MAX) return;
+
+        if (!ev.velocity) {
+            if (triggers[voice] != peaks::CONTROL_GATE_RISING)
+                choked[voice] = true;
+            return;
+        }
+
+        // the other voices of the group stop where this one starts. Groups
+        // are per part
+        if (choke_groups[voice]) {
+            unsigned first = voice - voice % DrumKit::VOICE_COUNT;
+            for (unsigned other = first; other < first + DrumKit::VOICE_COUNT;
+                 ++other)
+                if (other != voice && choke_groups[other] == choke_groups[voice]
+                    && triggers[other] != peaks::CONTROL_GATE_RISING)
+                    choked[other] = true;
+        }
+
+        LATENCY_APPLIED(ev.received);
+
+        if (!playing(voice)) steal_voice();
+        started[voice] = ++hits;
+
+        unlock(voice);
+        lock(voice, ev);
+
+        DrumKit &kit = kits[voice / DrumKit::VOICE_COUNT];
+        unsigned kv = voice % DrumKit::VOICE_COUNT;
+        kit.set_velocity(kv, curves[voice].map(ev.velocity), accent(ev.velocity));
+        kit.set_variant(kv, ev.variant);
+        triggers[voice] = peaks::CONTROL_GATE_RISING;
+        choked[voice] = false;
+    }
+
+    // voice renders the next block: triggered, or sounding and not choked
+    bool playing(unsigned voice) const {
+        if (triggers[voice] == peaks::CONTROL_GATE_RISING) return true;
+        return !settled[voice] && !choked[voice];
+    }
+
+    // makes room for one more voice within the budget, choking the voice
+    // that started longest ago. Voices triggered in this block are kept
+    void steal_voice() {
+        unsigned active = 0;
+        int oldest = -1;
+        for (unsigned v = 0; v < VOICE_MAX; ++v) {
+            if (!playing(v)) continue;
+            ++active;
+            if (triggers[v] == peaks::CONTROL_GATE_RISING) continue;
+            if (oldest < 0 || hits - started[v] > hits - started[oldest])
+                oldest = v;
+        }
+
+        if (active >= VOICE_BUDGET && oldest >= 0) choked[oldest] = true;
+    }
+
+    // applies the locks of the hit, keeping the voice's own values
+    void lock(unsigned voice, const TriggerEvent &ev) {
+        unsigned count = ev.lock_count;
+        if (count > LOCK_MAX) count = LOCK_MAX;
+        for (unsigned i = 0; i < count; ++i) {
+            const ParamLock &pl = ev.locks[i];
+            if (pl.param >= DrumKit::param_count(voice % DrumKit::VOICE_COUNT))
+                continue;
+
+            if (lock_slot(voice, pl.param) < 0) {
+                locked[voice][lock_count[voice]++] =
+                    {pl.param, kit_param(voice, pl.param)};
+            }
+            set_kit_param(voice, pl.param, pl.value);
+        }
+    }
+
+    // restores the values the locks of the last hit replaced
+    void unlock(unsigned voice) {
+        for (unsigned i = 0; i < lock_count[voice]; ++i)
+            set_kit_param(voice, locked[voice][i].param, locked[voice][i].value);
+        lock_count[voice] = 0;
+    }
+
+    // parameter of a voice as its kit holds it
+    uint16_t kit_param(unsigned voice, unsigned param) const {
+        return kits[voice / DrumKit::VOICE_COUNT]
+               .get_param(voice % DrumKit::VOICE_COUNT, param);
+    }
+
+    void set_kit_param(unsigned voice, unsigned param, uint16_t value) {
+        kits[voice / DrumKit::VOICE_COUNT]
+            .set_param(voice % DrumKit::VOICE_COUNT, param, value);
+    }
+
+    // index into locked[voice] of the parameter, -1 if not locked
+    int lock_slot(unsigned voice, unsigned param) const {
+        for (unsigned i = 0; i < lock_count[voice]; ++i)
+            if (locked[voice][i].param == param) return i;
+        return -1;
+    }
+
+    /* renders a block of one voice. Pending trigger applies to the first sample.
+       Once the envelopes of a voice finished and a block of its output
+       settled, the voice is skipped and holds its last sample until triggered
+       again. Filters may ring on after the envelopes, or settle on a small
+       offset, hence the hold rather than zeros */
+    template<typename Voice>
+    DSP_HOT void render_voice(Voice &voice, unsigned chan)
+    {
+        int16_t *out = mixer.get_channel_buffer((Mixer::Channel)chan);
+        peaks::ControlBitMask &trigger = triggers[chan];
+
+        if (choked[chan]) {
+            choked[chan] = false;
+            if (!settled[chan]) {
+                choke_voice(voice, out, chan);
+                return;
+            }
+        }
+
+        if (trigger != peaks::CONTROL_GATE_RISING && settled[chan]) {
+            for (unsigned i = 0; i < Mixer::BLOCK_SIZE; ++i) out[i] = held[chan];
+            return;
+        }
+
+        voice.Render(trigger, out, Mixer::BLOCK_SIZE);
+        trigger = peaks::CONTROL_GATE;
+
+        held[chan] = out[Mixer::BLOCK_SIZE - 1];
+        settled[chan] = voice.finished() &&
+                        is_flat(out, Mixer::BLOCK_SIZE, held[chan]);
+    }
+
+    /* renders the last block of a choked voice, faded out, and stops it.
+       The voice is idle from here on */
+    template<typename Voice>
+    DSP_HOT void choke_voice(Voice &voice, int16_t *out, unsigned chan)
+    {
+        voice.Render(peaks::CONTROL_GATE, out, Mixer::BLOCK_SIZE);
+        voice.Choke();
+
+        // linear fade over the block, against the click of a hard stop
+        for (unsigned i = 0; i < Mixer::BLOCK_SIZE; ++i)
+            out[i] = out[i] * int32_t(Mixer::BLOCK_SIZE - 1 - i)
+                     / int32_t(Mixer::BLOCK_SIZE);
+
+        held[chan] = 0;
+        settled[chan] = true;
+    }
+
+    // kit visitors
+    struct RenderVoice {
+        Drummer &drummer;
+
+        template<typename Voice>
+        DSP_HOT void operator()(Voice &voice, unsigned chan) {
+            drummer.render_voice(voice, chan);
+        }
+    };
+
+    // all samples within QUIET of the given level
+    static bool is_flat(const int16_t *block, size_t size, int16_t level) {
+        for (size_t i = 0; i < size; ++i)
+            if (abs(block[i] - level) > QUIET) return false;
+        return true;
+    }
+
+    // renders blocks until the I2S DMA buffers are full. Never waits for DMA
+    DSP_HOT void feed_i2s() {
+        // had the DMA been full at the last call, it can only run dry if
+        // we're back later than its whole length of audio
+        uint32_t now = micros();
+        if (dma_was_full && now - last_full > dma_duration) ++underruns;
+        dma_was_full = false;
+
+        // at most the whole DMA length worth of blocks, so that MIDI and UI
+        // get their turn even if rendering can't keep up
+        for (unsigned blocks = 0; blocks <= dma_blocks;) {
+            if (out_pos == sizeof(out_block)) {
+                render_block();
+                out_pos = 0;
+                ++blocks;
+            }
+
+            int written = i2s_write_bytes((i2s_port_t)i2s_num,
+                                          (const char *)out_block + out_pos,
+                                          sizeof(out_block) - out_pos, 0);
+            if (written > 0) {
+                if (!out_pos) LATENCY_QUEUED();
+                out_pos += written;
+            }
+
+            if (out_pos < sizeof(out_block)) {
+                dma_was_full = true;
+                last_full = micros();
+                return;
+            }
+        }
+    }
+
+    // converts interleaved mix bus frames to the I2S sample format
+    DSP_HOT void to_i2s(const int32_t *in, i2s_sample_t *out) {
+        for (unsigned i = 0; i < Mixer::BLOCK_SIZE * 2; ++i) {
+#if I2S_OUTPUT_BITS == 16
+#if I2S_DITHER
+            // triangular noise of +-1 LSB of the 16 bit output
+            dither_state = dither_state * 1664525L + 1013904223L;
+            int32_t noise = int32_t(dither_state & 0xFF)
+                          + int32_t((dither_state >> 8) & 0xFF) - 255;
+            out[i] = bus_to_16(in[i] + noise);
+#else
+            out[i] = bus_to_16(in[i]);
+#endif
+#else
+            out[i] = in[i] << (32 - 16 - BUS_SHIFT);
+#endif
+        }
+    }
+
+    // smoothed ratio of render time to the duration of the rendered audio
+    void update_load(uint32_t spent, unsigned samples) {
+        if (!samples || !cycles_per_sample) return;
+        uint32_t budget = samples * cycles_per_sample;
+        uint32_t current = spent >= budget ? 65535 : (uint64_t)spent * 65535 / budget;
+        load += ((int32_t)current - (int32_t)load) >> 3;
+    }
+
+    void publish_status() {
+        Status st;
+        mixer.take_meters(st.meters);
+        st.load = load;
+        st.underruns = underruns;
+        status.publish(st);
+        status_blocks = 0;
+    }
+
+    // parameters the drummer adds to those of every voice
+    enum VoiceParam {
+        VP_CURVE_SHAPE = 0, // velocity curve, see VelocityCurve
+        VP_CURVE_DEPTH,
+        VP_CHOKE_GROUP,     // voices of a group cut each other off
+
+        VP_COUNT
+    };
+
+    // choke groups besides 0, which is none
+    static constexpr unsigned CHOKE_GROUPS = 3;
+
+    // blocks between two status publications (~25ms)
+    static constexpr unsigned STATUS_PERIOD = 32;
+
+    // voices rendering at once, see LITTLEBEAT_VOICE_BUDGET
+    static constexpr unsigned VOICE_BUDGET = LITTLEBEAT_VOICE_BUDGET;
+    static_assert(VOICE_BUDGET >= 1, "the voice budget takes at least one voice");
+
+    // voice output variation taken for silence (~-78dB)
+    static constexpr int16_t QUIET = 4;
+
+    static_assert(Mixer::BLOCK_SIZE <= peaks::Envelope::MAX_BLOCK,
+                  "voices render at most Envelope::MAX_BLOCK samples at once");
+
+    // stereo interleaved - the I2S frame layout
+    i2s_sample_t out_block[Mixer::BLOCK_SIZE * 2];
+    uint32_t dither_state = 1;
+    size_t out_pos = sizeof(out_block); // bytes of out_block already sent
+
+    uint32_t cycles_per_sample = 0;
+    uint16_t load = 0;
+
+    // underrun estimation
+    uint32_t dma_duration = 0; // us of audio the DMA buffers hold
+    unsigned dma_blocks = 0;   // blocks the DMA buffers hold
+    bool dma_was_full = false;
+    uint32_t last_full = 0;
+    uint32_t underruns = 0;
+
+    Snapshot<Status> status;
+    unsigned status_blocks = 0;
+
+    // per voice of all parts
+    VelocityCurve curves[VOICE_MAX];
+    uint8_t choke_groups[VOICE_MAX] = {};
+    peaks::ControlBitMask triggers[VOICE_MAX] = {};
+    bool choked[VOICE_MAX] = {}; // pending choke, see choke()
+
+    // own values of the parameters the current hit locked
+    ParamLock locked[VOICE_MAX][LOCK_MAX];
+    uint8_t lock_count[VOICE_MAX] = {};
+
+    // hit counter at the last trigger of each voice, the oldest gets stolen
+    uint32_t started[VOICE_MAX] = {};
+    uint32_t hits = 0;
+
+    // hits and chokes on their way to the audio path
+    EventQueue<TriggerEvent, 32> events;
+
+    // voices skipped until triggered again, see render_voice
+    bool settled[VOICE_MAX] = {};
+    int16_t held[VOICE_MAX] = {};
+
+    DrumKit kits[PART_COUNT];
 
     // mixes the sounds
     Mixer mixer;
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "placement.h"
+
+namespace peaks {
+
+// Sample and table helpers shared by the voices and their building blocks,
+// as in stmlib's utils/dsp.h.
+
+static inline int32_t CLIP(int32_t sample) {
+    if (sample < -32768)
+        return -32768;
+    if (sample > +32767)
+        return +32767;
+    return sample;
+}
+
+DSP_HOT inline int16_t Interpolate824(const int16_t *table, uint32_t phase) {
+    int32_t a = table[phase >> 24];
+    int32_t b = table[(phase >> 24) + 1];
+    return a + ((b - a) * static_cast<int32_t>((phase >> 8) & 0xffff) >> 16);
+}
+
+DSP_HOT inline uint16_t Interpolate824(const uint16_t *table, uint32_t phase) {
+    uint32_t a = table[phase >> 24];
+    uint32_t b = table[(phase >> 24) + 1];
+    return a + ((b - a) * static_cast<uint32_t>((phase >> 8) & 0xffff) >> 16);
+}
+
+DSP_HOT inline int16_t Interpolate824(const uint8_t *table, uint32_t phase) {
+    int32_t a = table[phase >> 24];
+    int32_t b = table[(phase >> 24) + 1];
+    return (a << 8) + ((b - a) * static_cast<int32_t>(phase & 0xffffff) >> 16) -
+           32768;
+}
+
+DSP_HOT inline int16_t Interpolate1022(const int16_t* table, uint32_t phase) {
+  int32_t a = table[phase >> 22];
+  int32_t b = table[(phase >> 22) + 1];
+  return a + ((b - a) * static_cast<int32_t>((phase >> 6) & 0xffff) >> 16);
+}
+
+// scales a level by a 16 bit gain, 65535 leaves it as is
+inline int32_t ScaleLevel(int32_t level, uint16_t gain) {
+    return (int64_t)level * (gain + 1) >> 16;
+}
+
+inline int16_t Mix(int16_t a, int16_t b, uint16_t balance) {
+  return (a * (65535 - balance) + b * balance) >> 16;
+}
+
+inline uint16_t Mix(uint16_t a, uint16_t b, uint16_t balance) {
+  return (a * (65535 - balance) + b * balance) >> 16;
+}
+
+} // namespace peaks
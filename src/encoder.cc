@@ -0,0 +1,61 @@
+#include "encoder.h"
+
+namespace {
+
+// direction of a transition, indexed by (previous AB state << 2) | new AB state.
+// Invalid transitions (both pins changed - a bounce or a missed edge) count as 0.
+// A falling while B is low counts as up, as did the original polled decoding.
+const int8_t DRAM_ATTR transitions[16] = {
+     0, +1, -1,  0,
+    -1,  0,  0, +1,
+    +1,  0,  0, -1,
+     0, -1, +1,  0
+};
+
+} // namespace
+
+void RotaryEncoder::begin() {
+    pinMode(pin_a, INPUT_PULLUP);
+    pinMode(pin_b, INPUT_PULLUP);
+
+    state = read_state();
+    last_move = millis();
+
+    attachInterruptArg(digitalPinToInterrupt(pin_a), isr, this, CHANGE);
+    attachInterruptArg(digitalPinToInterrupt(pin_b), isr, this, CHANGE);
+}
+
+void IRAM_ATTR RotaryEncoder::isr(void *arg) {
+    RotaryEncoder *enc = static_cast<RotaryEncoder *>(arg);
+
+    uint8_t cur = enc->read_state();
+    int8_t dir = transitions[(enc->state << 2) | cur];
+    enc->state = cur;
+
+    if (dir) enc->position.fetch_add(dir, std::memory_order_relaxed);
+}
+
+int RotaryEncoder::read() {
+    int32_t pos = position.load(std::memory_order_relaxed);
+
+    // partial detents stay in the position for the next read
+    int detents = (pos - consumed) / STEPS_PER_DETENT;
+    if (!detents) return 0;
+
+    consumed += detents * STEPS_PER_DETENT;
+
+    // turning speed since the previous movement
+    unsigned long now = millis();
+    unsigned long elapsed = now - last_move;
+    last_move = now;
+
+    unsigned rate = abs(detents) * 1000 / (elapsed ? elapsed : 1);
+    if (rate <= ACCEL_RATE_MIN) {
+        accel = 1;
+    } else {
+        accel = 1 + (rate - ACCEL_RATE_MIN) / ACCEL_RATE_STEP;
+        if (accel > ACCEL_MAX) accel = ACCEL_MAX;
+    }
+
+    return detents;
+}
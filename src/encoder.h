@@ -0,0 +1,48 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+// Quadrature rotary encoder decoded in GPIO interrupts. The ISR only
+// accumulates the position, so no steps are lost when loop() is busy.
+// Turning speed (and thus acceleration) is evaluated when reading.
+class RotaryEncoder {
+public:
+    RotaryEncoder(byte pin_a, byte pin_b) : pin_a(pin_a), pin_b(pin_b) {}
+
+    void begin();
+
+    // detents turned since the last call. Positive is up
+    int read();
+
+    // step multiplier for the last movement. 1 when turning slowly
+    unsigned acceleration() const { return accel; }
+
+protected:
+    static void isr(void *arg);
+
+    // called from isr(), so in IRAM as well. digitalRead is in IRAM in the core
+    IRAM_ATTR uint8_t read_state() const {
+        return (digitalRead(pin_a) << 1) | digitalRead(pin_b);
+    }
+
+    // quadrature transitions per mechanical detent
+    static constexpr int STEPS_PER_DETENT = 4;
+
+    // acceleration kicks in above this many detents per second...
+    static constexpr unsigned ACCEL_RATE_MIN = 10;
+    // ...and adds one to the multiplier for each this many detents per second
+    static constexpr unsigned ACCEL_RATE_STEP = 5;
+    static constexpr unsigned ACCEL_MAX = 16;
+
+    byte pin_a, pin_b;
+
+    // written only by the ISR
+    uint8_t state = 0;
+    std::atomic<int32_t> position{0};
+
+    // owned by the reader
+    int32_t consumed = 0; // position already reported by read()
+    unsigned long last_move = 0;
+    unsigned accel = 1;
+};
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "placement.h"
+
+namespace peaks {
+
+// Exponential decay with an optional delay, used by the voices both as
+// excitation pulses and as VCA/pitch envelopes. The per sample decay factor
+// is turned into a table of its powers when it is set, so a block renders
+// from its start level alone: sample k is the level times factor^k, with no
+// dependency between samples. Once the level falls under the floor the
+// envelope is finished and stays at zero until triggered again.
+class Envelope {
+public:
+    // longest block rendered in one go
+    static constexpr unsigned MAX_BLOCK = 32;
+
+    // levels under this are inaudible at the >> 4 the voices apply
+    static constexpr uint32_t DEFAULT_FLOOR = 16;
+
+    void Init() {
+        delay_   = 0;
+        counter_ = 0;
+        state_   = 0;
+        level_   = 0;
+        floor_   = DEFAULT_FLOOR;
+        set_decay(4093);
+    }
+
+    // samples between the trigger and the level appearing
+    void set_delay(uint32_t delay) { delay_ = delay; }
+
+    // decay factor per sample, Q12
+    void set_decay(uint16_t decay) {
+        set_decay_factor(decay / 4096.0f);
+    }
+
+    void set_decay_factor(float factor) {
+        if (factor == factor_) return;
+        factor_ = factor;
+
+        // Q31
+        float power = 2147483648.0f;
+        for (unsigned k = 0; k <= MAX_BLOCK; ++k) {
+            powers_[k] = power;
+            power *= factor;
+        }
+    }
+
+    // level under which the envelope counts as finished
+    void set_floor(uint32_t floor) { floor_ = floor; }
+
+    void Trigger(int32_t level) {
+        level_   = level;
+        counter_ = delay_ + 1;
+        // this breaks the continuity of things, but without it bass drum
+        // repetitions break
+        state_   = 0;
+    }
+
+    // silences the envelope at once, finished() from here on
+    void Stop() {
+        counter_ = 0;
+        state_   = 0;
+    }
+
+    // done - the delay has passed
+    bool done() const { return counter_ == 0; }
+
+    // finished - as in delay passed and the level decayed to zero
+    bool finished() const { return state_ == 0 && counter_ == 0; }
+
+    // samples of the next block rendered before the delayed level appears,
+    // done() is false for exactly these
+    uint32_t waiting() const { return counter_ ? counter_ - 1 : 0; }
+
+    // renders size samples, size <= MAX_BLOCK
+    DSP_HOT void Render(int32_t *out, size_t size) {
+        for (size_t i = 0; i < size;)
+            i += RenderSegment(out + i, size - i);
+    }
+
+    // renders up to size samples, but stops after the sample in which the
+    // envelope finished. Returns the samples rendered
+    DSP_HOT size_t RenderSegment(int32_t *out, size_t size) {
+        return Run<true>(out, size);
+    }
+
+    // advances size samples without rendering them, size <= MAX_BLOCK
+    DSP_HOT void Skip(size_t size) {
+        Run<false>(nullptr, size);
+    }
+
+    // renders one sample, then skips ahead so that advance samples passed
+    DSP_HOT int32_t Process(size_t advance = 1) {
+        int32_t out;
+        Run<true>(&out, 1);
+        if (advance > 1) Skip(advance - 1);
+        return out;
+    }
+
+private:
+    template<bool OUTPUT>
+    DSP_HOT size_t Run(int32_t *out, size_t size) {
+        size_t i = 0;
+
+        if (counter_) {
+            // the level is zero until the delay passes (see Trigger)
+            uint32_t wait = counter_ - 1;
+            if (wait >= size) {
+                if (OUTPUT) memset(out, 0, size * sizeof(*out));
+                counter_ -= size;
+                return size;
+            }
+
+            if (OUTPUT) memset(out, 0, wait * sizeof(*out));
+            i = wait;
+            counter_ = 0;
+            state_ = level_ < 0 ? -level_ : level_;
+        }
+
+        if (!state_) {
+            if (OUTPUT) memset(out + i, 0, (size - i) * sizeof(*out));
+            return size;
+        }
+
+        if (OUTPUT) {
+            bool negative = level_ < 0;
+            for (size_t k = 0; i + k < size; ++k) {
+                uint32_t value = (uint64_t)state_ * powers_[k] >> 31;
+                if (value < floor_) {
+                    out[i + k] = 0;
+                    state_ = 0;
+                    return i + k + 1;
+                }
+                out[i + k] = negative ? -(int32_t)value : value;
+            }
+        }
+
+        state_ = (uint64_t)state_ * powers_[size - i] >> 31;
+        if (state_ < floor_) state_ = 0;
+        return size;
+    }
+
+    uint32_t delay_;
+    uint32_t counter_;
+    uint32_t state_; // level of the next sample
+    int32_t  level_;
+    uint32_t floor_;
+
+    float factor_ = -1.0f;
+    uint32_t powers_[MAX_BLOCK + 1]; // factor^k, Q31
+};
+
+} // namespace peaks
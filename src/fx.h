@@ -2,6 +2,49 @@
 
 #include <Arduino.h>
 
+#include "placement.h"
+#include "lut.h"
+
+// output sample rate (see i2s_config)
+constexpr uint32_t SAMPLE_RATE = 41100;
+
+// The mix bus carries 16 bit samples scaled up by BUS_SHIFT bits (24 bits),
+// so that channel gains and FX returns don't truncate to 16 bits.
+constexpr unsigned BUS_SHIFT = 8;
+constexpr int32_t  BUS_FULL_SCALE = 32767 << BUS_SHIFT;
+
+// clips a bus sample to the 16 bit range the delay lines store
+inline int16_t bus_to_16(int32_t sample) {
+    sample >>= BUS_SHIFT;
+    if (sample < -32768) return -32768;
+    if (sample > 32767) return 32767;
+    return sample;
+}
+
+// log2 of a positive float, within 0.01 (~0.06dB). Inline arithmetic on
+// the float bits, so the audio path needn't call into libm in flash
+inline float fast_log2(float x) {
+    union { float f; uint32_t i; } u = {x};
+    int exponent = int((u.i >> 23) & 0xFF) - 128;
+    u.i = (u.i & 0x007FFFFF) | 0x3F800000; // mantissa, in [1, 2)
+    float m = u.f;
+    return ((-1.0f / 3) * m + 2.0f) * m - 2.0f / 3 + exponent;
+}
+
+// 2 to the power of x, within 0.35% (~0.03dB). 0 below 2^-126
+inline float fast_exp2(float x) {
+    if (x < -126.0f) return 0.0f;
+    if (x > 127.0f) x = 127.0f;
+
+    int whole = int(x);
+    if (whole > x) --whole; // floor
+    float f = x - whole;
+
+    union { float f; uint32_t i; } u;
+    u.i = uint32_t(whole + 127) << 23;
+    return u.f * (1.0f + f * (0.6565f + 0.3435f * f));
+}
+
 // pushes on top, retrieves from end
 template<unsigned LEN>
 class RingBuffer {
@@ -15,6 +58,16 @@ public:
         return buffer[next_pos()];
     }
 
+    // sample pushed delay pushes ago (1 is the last one), delay <= LEN
+    int16_t tap(unsigned delay) const {
+        return buffer[(pos + LEN - delay) % LEN];
+    }
+
+    void clear() {
+        memset(buffer, 0, sizeof(buffer));
+        pos = 0;
+    }
+
 protected:
     unsigned next_pos() const {
         return (pos + 1) % LEN;
@@ -24,38 +77,53 @@ protected:
     int16_t buffer[LEN];
 };
 
-// TODO: redo this to use comb filter to save code
-// monophonic echo
+// monophonic feedback delay. Takes mix bus samples and returns the wet signal
 class Echo {
 public:
     Echo() {}
     ~Echo() {}
 
-    void Process(int16_t &left, int16_t &right) {
-        int16_t cur_value = (left+right)/2;
-        int16_t past = buffer.get();
+    // replaces a block of bus samples with the echoes
+    DSP_HOT void process(int32_t *left, int32_t *right, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            int32_t cur = bus_to_16((left[i] + right[i]) >> 1);
+            int32_t past = buffer.tap(delay);
 
-        buffer.push(cur_value - (past * decay >> 16));
+            int32_t fed = cur + (past * feedback >> 16);
+            if (fed < -32768) fed = -32768;
+            if (fed > 32767) fed = 32767;
+            buffer.push(fed);
 
-        left += past;
-        right += past;
+            left[i] = right[i] = past << BUS_SHIFT;
+        }
     }
 
+    // delay time, full range is BUF_LEN samples (~0.4s)
     void set_delay(uint16_t del) {
-        delay = del >> 2;
+        delay = 1 + ((uint32_t)del * (BUF_LEN - 1) >> 16);
+    }
+
+    // part of the echo fed back (Q16)
+    void set_feedback(uint16_t fb) {
+        feedback = fb;
+    }
+
+    // samples an input takes to come out
+    unsigned tail() const {
+        return delay;
     }
 
-    void set_decay(uint16_t dec) {
-        decay = dec;
+    void clear() {
+        buffer.clear();
     }
 
 protected:
     static constexpr unsigned BUF_LEN = 1 << 14;
 
-    uint16_t delay = BUF_LEN;
-    uint16_t decay = 0x4000;
+    unsigned delay = BUF_LEN / 2;
+    uint16_t feedback = 0x4000;
 
-    RingBuffer<16384> buffer;
+    RingBuffer<BUF_LEN> buffer;
 };
 
 // comb filter
@@ -63,7 +131,7 @@ template<uint32_t Len>
 struct Comb {
     Comb(uint16_t feedback = 32768) : feedback(feedback) {}
 
-    int16_t process(int16_t input) {
+    DSP_HOT int16_t process(int16_t input) {
         int16_t res = buffer[pos];
         buffer[pos] = input + (res * feedback >> 16);
         pos = (pos + 1) % Len;
@@ -74,6 +142,10 @@ struct Comb {
         feedback = fb;
     }
 
+    void clear() {
+        memset(buffer, 0, sizeof(buffer));
+    }
+
     uint16_t feedback = 32768;
     uint32_t pos = 0;
     int16_t buffer[Len];
@@ -84,7 +156,7 @@ template<uint32_t Len>
 struct Allpass {
     Allpass(uint16_t feedback = 32768) : feedback(feedback) {}
 
-    int16_t process(int16_t input) {
+    DSP_HOT int16_t process(int16_t input) {
         int16_t bout = buffer[pos];
         buffer[pos] = input + (bout * feedback >> 16);
         int16_t output = bout - (buffer[pos] * feedback >> 16);
@@ -92,15 +164,20 @@ struct Allpass {
         return output;
     }
 
+    void clear() {
+        memset(buffer, 0, sizeof(buffer));
+    }
+
     uint16_t feedback = 32768;
     uint32_t pos = 0;
     int16_t buffer[Len];
 };
 
-// really quite a compromise reverb, but it works reasonably well
-// inspired by jcrev and freeverb (a hybrid of the two)
-struct Reverb {
-    Reverb()
+// one set of filters of the reverb. SPREAD lengthens every delay line so
+// that two sets decorrelate (freeverb spreads its sides by 23 samples)
+template<uint32_t SPREAD>
+struct ReverbTank {
+    ReverbTank()
             : ap1(0.5 * 65535)
             , ap2(0.5 * 65535)
             , ap3(0.5 * 65535)
@@ -109,19 +186,9 @@ struct Reverb {
             , c2(0.802 * 65535)
             , c3(0.753 * 65535)
             , c4(0.733 * 65535)
-    {
-        // this sets the same constants as specified by jcrev
-        set_feedback(54612);
-    }
+    {}
 
-    void Process(int16_t &left, int16_t &right) {
-        int16_t mix = (left + right) >> 1;
-        int16_t rev = process(mix);
-        left += rev;
-        right += rev;
-    }
-
-    int16_t process(int16_t src) {
+    DSP_HOT int16_t process(int16_t src) {
         int32_t r1 = c1.process(src);
         int32_t r2 = c2.process(src);
         int32_t r3 = c3.process(src);
@@ -149,16 +216,483 @@ struct Reverb {
         c4.set_feedback(1.2 * 0.733 * fb);
     }
 
+    void clear() {
+        ap1.clear(); ap2.clear(); ap3.clear(); ap4.clear();
+        c1.clear(); c2.clear(); c3.clear(); c4.clear();
+    }
+
+    // samples an input takes to pass the longest path through the filters
+    static constexpr uint32_t TAIL = 2251 + 225 + 556 + 441 + 341 + 5 * SPREAD;
 
     // allpass in series
-    Allpass<225> ap1;
-    Allpass<556> ap2;
-    Allpass<441> ap3;
-    Allpass<341> ap4;
+    Allpass<225 + SPREAD> ap1;
+    Allpass<556 + SPREAD> ap2;
+    Allpass<441 + SPREAD> ap3;
+    Allpass<341 + SPREAD> ap4;
 
     // comb filters, parallel
-    Comb<1687> c1;
-    Comb<1601> c2;
-    Comb<2053> c3;
-    Comb<2251> c4;
+    Comb<1687 + SPREAD> c1;
+    Comb<1601 + SPREAD> c2;
+    Comb<2053 + SPREAD> c3;
+    Comb<2251 + SPREAD> c4;
+};
+
+// really quite a compromise reverb, but it works reasonably well
+// inspired by jcrev and freeverb (a hybrid of the two).
+// In stereo mode each side has its own, slightly longer tank and the width
+// crossmixes the two. Width 0 is the mono mode, which runs one tank only
+// and costs half as much
+struct Reverb {
+    Reverb() {
+        // this sets the same constants as specified by jcrev
+        set_feedback(54612);
+    }
+
+    // replaces a block of bus samples with the reverb. The delay lines keep
+    // 16 bits to save memory, so only the signal entering them is reduced
+    // to 16 bits
+    DSP_HOT void process(int32_t *left, int32_t *right, size_t size) {
+        if (!width) {
+            for (size_t i = 0; i < size; ++i) {
+                int16_t mix = bus_to_16((left[i] + right[i]) >> 1);
+                int32_t rev = tank_l.process(mix);
+                left[i] = right[i] = rev << BUS_SHIFT;
+            }
+            return;
+        }
+
+        for (size_t i = 0; i < size; ++i) {
+            int16_t mix = bus_to_16((left[i] + right[i]) >> 1);
+            int32_t rev_l = tank_l.process(mix);
+            int32_t rev_r = tank_r.process(mix);
+            left[i]  = (rev_l * wet1 + rev_r * wet2) >> (15 - BUS_SHIFT);
+            right[i] = (rev_r * wet1 + rev_l * wet2) >> (15 - BUS_SHIFT);
+        }
+    }
+
+    void set_feedback(uint16_t fb) {
+        tank_l.set_feedback(fb);
+        tank_r.set_feedback(fb);
+    }
+
+    // stereo width, 0 selects the mono mode
+    void set_width(uint16_t w) {
+        // the right tank stood still in mono mode, drop what it held
+        if (w && !width) tank_r.clear();
+
+        width = w;
+        wet1 = 16384 + (w >> 2); // Q15, wet1 + wet2 is unity
+        wet2 = 16384 - (w >> 2);
+    }
+
+    // samples an input takes to pass the longest path through the filters
+    unsigned tail() const {
+        return width ? Right::TAIL : Left::TAIL;
+    }
+
+    void clear() {
+        tank_l.clear();
+        tank_r.clear();
+    }
+
+protected:
+    using Left  = ReverbTank<0>;
+    using Right = ReverbTank<23>;
+
+    uint16_t width = 0;
+    int32_t wet1 = 32768;
+    int32_t wet2 = 0;
+
+    Left  tank_l;
+    Right tank_r;
+};
+
+// Feedback delay network reverb, a denser alternative to Reverb. N lines
+// (4 or 8) of mutually prime lengths are fed back through a Householder
+// matrix, which mixes every line into all others at the cost of one sum.
+// Each line is lowpassed in the loop (damping) and its length slowly
+// modulated, which breaks up the periodic ringing of long decays. Two
+// allpasses diffuse the input before it enters the lines. The
+// modulation and interpolation weights are updated once per block.
+// Even lines feed the left output, odd lines the right one.
+template<unsigned N>
+class FdnReverb {
+    static_assert(N == 4 || N == 8, "FdnReverb has 4 or 8 lines");
+
+public:
+    FdnReverb() {
+        int16_t *line = buffer;
+        for (unsigned i = 0; i < N; ++i) {
+            len[i]  = length(i);
+            base[i] = line;
+            size[i] = len[i] + MOD_DEPTH + 2;
+            pos[i]  = 0;
+            line += size[i];
+        }
+
+        clear();
+        set_feedback(54612);
+        set_damping(24576);
+        set_width(0);
+        update_modulation();
+    }
+
+    // replaces a block of bus samples with the reverb
+    DSP_HOT void process(int32_t *left, int32_t *right, size_t size) {
+        update_modulation();
+
+        for (size_t i = 0; i < size; ++i) {
+            int16_t in = bus_to_16((left[i] + right[i]) >> 1) >> 1;
+            in = diffuse2.process(diffuse1.process(in));
+
+            int32_t x[N];
+            int32_t sum = 0;
+            for (unsigned l = 0; l < N; ++l) {
+                x[l] = damp(l, read(l));
+                sum += x[l];
+            }
+
+            // Householder reflection: x - 2/N * sum(x)
+            int32_t reflect = sum >> (LOG2_N - 1);
+            int32_t out_l = 0, out_r = 0;
+            for (unsigned l = 0; l < N; ++l) {
+                int32_t fb = (x[l] - reflect) * gain[l] >> 14;
+                write(l, (l & 2) ? fb - in : fb + in);
+
+                if (l & 1) out_r += x[l]; else out_l += x[l];
+            }
+
+            out_l >>= LOG2_N - 1;
+            out_r >>= LOG2_N - 1;
+            left[i]  = (out_l * wet1 + out_r * wet2) >> (15 - BUS_SHIFT);
+            right[i] = (out_r * wet1 + out_l * wet2) >> (15 - BUS_SHIFT);
+        }
+    }
+
+    // loop gain (Q16) of a line of the reference length, longer lines get
+    // less so all of them decay at the same rate
+    void set_feedback(uint16_t fb) {
+        float g = fb / 65536.0f;
+        for (unsigned i = 0; i < N; ++i)
+            gain[i] = 16383 * powf(g, (float)len[i] / REFERENCE_LENGTH);
+    }
+
+    // lowpass coefficient in the loop (Q16), lower is darker
+    void set_damping(uint16_t d) {
+        damping = (d >> 1) + 1;
+    }
+
+    // stereo width, 0 sums both sides to mono
+    void set_width(uint16_t w) {
+        wet1 = 16384 + (w >> 2); // Q15, wet1 + wet2 is unity
+        wet2 = 16384 - (w >> 2);
+    }
+
+    // samples an input takes to come out of the longest line
+    unsigned tail() const {
+        return len[N - 1] + MOD_DEPTH;
+    }
+
+    void clear() {
+        memset(buffer, 0, sizeof(buffer));
+        memset(lp, 0, sizeof(lp));
+        diffuse1.clear();
+        diffuse2.clear();
+    }
+
+protected:
+    static constexpr unsigned LOG2_N = N == 8 ? 3 : 2;
+
+    // modulation depth in samples and LFO phase increment per block (~0.4Hz)
+    static constexpr unsigned MOD_DEPTH = 12;
+    static constexpr uint32_t MOD_INCREMENT = 1340000;
+
+    static constexpr float REFERENCE_LENGTH = 1601.0f;
+
+    // lengths are mutually prime, the 4 line version takes every other one
+    static constexpr unsigned TOTAL_LENGTH = N == 8
+        ? 1109 + 1277 + 1433 + 1601 + 1753 + 1867 + 2029 + 2213
+        : 1277 + 1601 + 1867 + 2213;
+
+    static unsigned length(unsigned line) {
+        static const uint16_t lengths[8] = {
+            1109, 1277, 1433, 1601, 1753, 1867, 2029, 2213
+        };
+        return N == 8 ? lengths[line] : lengths[2 * line + 1];
+    }
+
+    // per block: delay of every line, split in whole samples and Q15 fraction
+    void update_modulation() {
+        lfo += MOD_INCREMENT;
+        for (unsigned i = 0; i < N; ++i) {
+            // spread the line phases evenly around the cycle
+            uint32_t phase = lfo + i * (0xffffffffu / N);
+            uint32_t mod = (uint32_t)(peaks::wav_sine[phase >> 22] + 32768) * MOD_DEPTH;
+            delay[i] = len[i] - MOD_DEPTH / 2 + (mod >> 16);
+            frac[i]  = (mod & 0xffff) >> 1;
+        }
+    }
+
+    DSP_HOT int32_t read(unsigned l) const {
+        int32_t r = (int32_t)pos[l] - (int32_t)delay[l];
+        if (r < 0) r += size[l];
+        int32_t r1 = r ? r - 1 : size[l] - 1;
+
+        int32_t a = base[l][r];
+        int32_t b = base[l][r1];
+        return a + ((b - a) * frac[l] >> 15);
+    }
+
+    DSP_HOT void write(unsigned l, int32_t value) {
+        if (value < -32768) value = -32768;
+        if (value > 32767) value = 32767;
+        base[l][pos[l]] = value;
+        if (++pos[l] >= size[l]) pos[l] = 0;
+    }
+
+    DSP_HOT int32_t damp(unsigned l, int32_t value) {
+        lp[l] += (value - lp[l]) * damping >> 15;
+        return lp[l];
+    }
+
+    int16_t *base[N];
+    uint16_t len[N];   // nominal delay
+    uint16_t size[N];  // buffer length, leaves room for the modulation
+    uint16_t pos[N];   // write position
+    uint16_t delay[N]; // current whole delay
+    int32_t  frac[N];  // current fractional delay, Q15
+    int32_t  gain[N];  // loop gain, Q14
+    int32_t  lp[N];    // damping state
+
+    // input diffusion, so the lines start out dense
+    Allpass<142> diffuse1 = Allpass<142>(0.75 * 65535);
+    Allpass<379> diffuse2 = Allpass<379>(0.625 * 65535);
+
+    uint32_t lfo = 0;
+    int32_t damping;
+    int32_t wet1;
+    int32_t wet2;
+
+    int16_t buffer[TOTAL_LENGTH + N * (MOD_DEPTH + 2)];
+};
+
+// Send bus feeding one effect, processed a block at a time. Channels add
+// their sends, then the effect runs over the whole block and its wet output
+// is mixed back at the return level. While nothing is sent and the effect's
+// tail has died out, the bus is skipped entirely.
+template<typename Fx, unsigned SIZE>
+class SendBus {
+public:
+    Fx &get_fx() {
+        return fx;
+    }
+
+    // true while the effect is being processed
+    bool is_running() const {
+        return running;
+    }
+
+    // adds a block of channel samples to the send
+    DSP_HOT void add(const int16_t *in, int32_t gain_l, int32_t gain_r) {
+        if (!fed) {
+            memset(left, 0, sizeof(left));
+            memset(right, 0, sizeof(right));
+            fed = true;
+        }
+        for (unsigned i = 0; i < SIZE; ++i) {
+            left[i]  += in[i] * gain_l >> (16 - BUS_SHIFT);
+            right[i] += in[i] * gain_r >> (16 - BUS_SHIFT);
+        }
+    }
+
+    // runs the effect and mixes its output into lt/rt at level (Q16)
+    DSP_HOT void mix_return(int32_t *lt, int32_t *rt, uint16_t level) {
+        if (!fed) {
+            if (!running) return;
+            memset(left, 0, sizeof(left));
+            memset(right, 0, sizeof(right));
+        }
+        running = true;
+
+        fx.process(left, right, SIZE);
+
+        int32_t peak = 0;
+        for (unsigned i = 0; i < SIZE; ++i) {
+            lt[i] += (int64_t)left[i] * level >> 16;
+            rt[i] += (int64_t)right[i] * level >> 16;
+
+            // both sides, a stereo or panned tail may outlast the left one
+            int32_t l = left[i] < 0 ? -left[i] : left[i];
+            int32_t r = right[i] < 0 ? -right[i] : right[i];
+            if (l > peak) peak = l;
+            if (r > peak) peak = r;
+        }
+
+        // idle once the output stayed quiet for longer than the effect
+        // holds on to its input
+        if (fed || peak > QUIET) {
+            quiet_blocks = 0;
+        } else if (++quiet_blocks > fx.tail() / SIZE + 1) {
+            fx.clear();
+            running = false;
+            quiet_blocks = 0;
+        }
+
+        fed = false;
+    }
+
+protected:
+    // output level counted as silence, ~-72dB. The 16 bit feedback loops
+    // truncate, so they settle into limit cycles of a few steps instead
+    // of decaying to zero
+    static constexpr int32_t QUIET = 8 << BUS_SHIFT;
+
+    Fx fx;
+
+    bool fed = false;     // something was sent this block
+    bool running = false;
+    unsigned quiet_blocks = 0;
+
+    int32_t left[SIZE];
+    int32_t right[SIZE];
+};
+
+// Peak limiter with a look-ahead of one block. The output is the previous
+// block, so the gain is already down when a peak arrives instead of clipping
+// it. Gain is stereo linked, computed once per block and ramped linearly
+// across the block. Works on int32 bus samples.
+template<unsigned SIZE>
+class Limiter {
+public:
+    // level the output peaks must stay under
+    void set_threshold(int32_t th) {
+        threshold = th > 0 ? th : 1;
+    }
+
+    // part of the gain reduction (Q16) recovered per block
+    void set_release(uint16_t rel) {
+        release = rel;
+    }
+
+    // limits a block in place. Delays the signal by SIZE samples
+    DSP_HOT void process(int32_t *left, int32_t *right) {
+        // stereo linked peak of the incoming block
+        int32_t peak = 0;
+        for (unsigned i = 0; i < SIZE; ++i) {
+            int32_t l = left[i] < 0 ? -left[i] : left[i];
+            int32_t r = right[i] < 0 ? -right[i] : right[i];
+            if (l > peak) peak = l;
+            if (r > peak) peak = r;
+        }
+
+        // gain the incoming block needs (Q16)
+        int32_t target = peak > threshold
+            ? ((int64_t)threshold << 16) / peak : UNITY;
+
+        // recover a bit, but never above what the delayed block or the
+        // incoming block need. Ramping between two gains that both suit
+        // the delayed block keeps all of it under the threshold
+        int32_t next = gain + ((int64_t)(UNITY - gain) * release >> 16);
+        if (next > target) next = target;
+        if (next > pending) next = pending;
+
+        int32_t step = (next - gain) / (int32_t)SIZE;
+        if (next < gain) --step; // round towards the lower gain
+
+        int32_t g = gain;
+        for (unsigned i = 0; i < SIZE; ++i) {
+            g += step;
+            if (g < next && step < 0) g = next;
+
+            int32_t l = (int64_t)delay_l[i] * g >> 16;
+            int32_t r = (int64_t)delay_r[i] * g >> 16;
+            delay_l[i] = left[i];
+            delay_r[i] = right[i];
+            left[i]  = l;
+            right[i] = r;
+        }
+
+        gain = next;
+        pending = target;
+    }
+
+protected:
+    static constexpr int32_t UNITY = 65536;
+
+    int32_t threshold = BUS_FULL_SCALE;
+    uint16_t release = 1200; // ~50ms to recover most of the reduction
+
+    int32_t gain = UNITY;    // gain at the end of the last output block
+    int32_t pending = UNITY; // gain the delayed block needs
+
+    int32_t delay_l[SIZE] = {};
+    int32_t delay_r[SIZE] = {};
+};
+
+// Feed-forward bus compressor. Level is detected from the block peak and the
+// gain computed once per block (in octaves of level, on the FPU, see
+// fast_log2), then ramped per sample.
+template<unsigned SIZE>
+class Compressor {
+public:
+    // threshold in dB below full scale
+    void set_threshold(float db) {
+        threshold = -db / DB_PER_OCTAVE;
+    }
+
+    // compression ratio, 1 or less turns the compressor off
+    void set_ratio(float r) {
+        slope = r > 1.0f ? 1.0f - 1.0f / r : 0.0f;
+    }
+
+    bool enabled() const {
+        return slope > 0.0f || gain != UNITY;
+    }
+
+    // compresses a block in place. full_scale is the bus level of 0 dB
+    DSP_HOT void process(int32_t *left, int32_t *right, int32_t full_scale) {
+        int32_t peak = 1;
+        for (unsigned i = 0; i < SIZE; ++i) {
+            int32_t l = left[i] < 0 ? -left[i] : left[i];
+            int32_t r = right[i] < 0 ? -right[i] : right[i];
+            if (l > peak) peak = l;
+            if (r > peak) peak = r;
+        }
+
+        float level = fast_log2((float)peak / full_scale);
+        if (level > envelope)
+            envelope += (level - envelope) * ATTACK;
+        else
+            envelope += (level - envelope) * RELEASE;
+
+        float reduction = envelope > threshold
+            ? (threshold - envelope) * slope : 0.0f;
+        int32_t next = UNITY * fast_exp2(reduction);
+
+        int32_t step = (next - gain) / (int32_t)SIZE;
+        int32_t g = gain;
+        for (unsigned i = 0; i < SIZE; ++i) {
+            g += step;
+            left[i]  = (int64_t)left[i] * g >> 16;
+            right[i] = (int64_t)right[i] * g >> 16;
+        }
+
+        gain = next;
+    }
+
+protected:
+    static constexpr int32_t UNITY = 65536;
+
+    // envelope coefficients per block (block is ~0.8ms)
+    static constexpr float ATTACK  = 0.3f;
+    static constexpr float RELEASE = 0.01f;
+
+    // 20 * log10(2)
+    static constexpr float DB_PER_OCTAVE = 6.0206f;
+
+    // levels in octaves (log2) below full scale
+    float threshold = -12.0f / DB_PER_OCTAVE;
+    float slope = 0.0f;
+    float envelope = -96.0f / DB_PER_OCTAVE;
+    int32_t gain = UNITY;
 };
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "peaks-drums.h"
+#include "fx.h"
+
+// Per channel insert effects. An insert processes a block of 16 bit channel
+// samples in place and exposes its settings as 16 bit parameters, same as
+// the voices do. Inserts are chained at compile time by InsertChain<...>.
+// An insert left out of the chain costs neither code nor memory, a bypassed
+// insert costs one branch per block.
+//
+// An insert has to provide:
+//   static constexpr unsigned PARAM_COUNT;
+//   static const char *param_name(unsigned idx);
+//   uint16_t get_param(unsigned idx) const;
+//   void set_param(unsigned idx, uint16_t value);
+//   bool active() const;                    // false when bypassed
+//   void process(int16_t *buf, size_t size);
+
+// peaking EQ (biquad). Coefficients are computed when a parameter changes,
+// the filter itself runs on the FPU
+class EqInsert {
+public:
+    static constexpr unsigned PARAM_COUNT = 3;
+
+    EqInsert() { update(); }
+
+    static const char *param_name(unsigned idx) {
+        switch (idx) {
+        case 0: return "EQ Freq";
+        case 1: return "EQ Gain";
+        case 2: return "EQ Q";
+        default: return "?";
+        }
+    }
+
+    uint16_t get_param(unsigned idx) const {
+        return idx < PARAM_COUNT ? params[idx] : 0;
+    }
+
+    void set_param(unsigned idx, uint16_t value) {
+        if (idx >= PARAM_COUNT) return;
+        params[idx] = value;
+        update();
+    }
+
+    bool active() const { return enabled; }
+
+    DSP_HOT void process(int16_t *buf, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            // transposed direct form II
+            float x = buf[i];
+            float y = b0 * x + z1;
+            z1 = b1 * x - a1 * y + z2;
+            z2 = b2 * x - a2 * y;
+            buf[i] = peaks::CLIP(y);
+        }
+    }
+
+protected:
+    void update() {
+        // 0dB in the middle of the gain range, with a small dead zone
+        int32_t gain = params[1] - 32768;
+        bool was_enabled = enabled;
+        enabled = gain < -256 || gain > 256;
+        if (!enabled) return;
+        if (!was_enabled) z1 = z2 = 0.0f;
+
+        // 40Hz-16kHz exponentially, +-12dB, Q 0.3-6.3
+        float freq = 40.0f * powf(400.0f, params[0] / 65535.0f);
+        float db   = 12.0f * gain / 32768.0f;
+        float q    = 0.3f + 6.0f * params[2] / 65535.0f;
+
+        // RBJ audio EQ cookbook, peaking EQ
+        float a = powf(10.0f, db / 40.0f);
+        float w = 2.0f * PI * freq / SAMPLE_RATE;
+        float alpha = sinf(w) / (2.0f * q);
+        float cw = cosf(w);
+        float norm = 1.0f / (1.0f + alpha / a);
+
+        b0 = (1.0f + alpha * a) * norm;
+        b1 = -2.0f * cw * norm;
+        b2 = (1.0f - alpha * a) * norm;
+        a1 = b1;
+        a2 = (1.0f - alpha / a) * norm;
+    }
+
+    uint16_t params[PARAM_COUNT] = {26000, 32768, 10000};
+    bool enabled = false;
+
+    float b0 = 1.0f, b1 = 0.0f, b2 = 0.0f, a1 = 0.0f, a2 = 0.0f;
+    float z1 = 0.0f, z2 = 0.0f;
+};
+
+// waveshaper drive, using the same overdrive table as the voices
+class DriveInsert {
+public:
+    static constexpr unsigned PARAM_COUNT = 1;
+
+    static const char *param_name(unsigned idx) {
+        return idx == 0 ? "Drive" : "?";
+    }
+
+    uint16_t get_param(unsigned idx) const {
+        return idx == 0 ? amount : 0;
+    }
+
+    void set_param(unsigned idx, uint16_t value) {
+        if (idx != 0) return;
+        amount = value;
+        // input gain 1x-8x, Q12
+        pre_gain = 4096 + (7 * (uint32_t)value >> 4);
+    }
+
+    bool active() const { return amount != 0; }
+
+    DSP_HOT void process(int16_t *buf, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            int32_t x = peaks::CLIP(buf[i] * pre_gain >> 12);
+            uint32_t phi = (static_cast<int32_t>(x) << 16) + (1L << 31);
+            int16_t overdriven = peaks::Interpolate1022(peaks::wav_overdrive, phi);
+            buf[i] = peaks::Mix(buf[i], overdriven, amount);
+        }
+    }
+
+protected:
+    uint16_t amount = 0;
+    int32_t pre_gain = 4096;
+};
+
+// bit depth and sample rate reduction
+class CrushInsert {
+public:
+    static constexpr unsigned PARAM_COUNT = 2;
+
+    static const char *param_name(unsigned idx) {
+        switch (idx) {
+        case 0: return "Crush";
+        case 1: return "Downsample";
+        default: return "?";
+        }
+    }
+
+    uint16_t get_param(unsigned idx) const {
+        return idx < PARAM_COUNT ? params[idx] : 0;
+    }
+
+    void set_param(unsigned idx, uint16_t value) {
+        if (idx >= PARAM_COUNT) return;
+        params[idx] = value;
+        // 16 bits down to 1 bit
+        mask = ~((1 << (params[0] >> 12)) - 1);
+        // hold each sample for 1-32 samples
+        hold = 1 + (params[1] >> 11);
+    }
+
+    bool active() const { return mask != -1 || hold > 1; }
+
+    DSP_HOT void process(int16_t *buf, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            if (++counter >= hold) {
+                counter = 0;
+                held = buf[i] & mask;
+            }
+            buf[i] = held;
+        }
+    }
+
+protected:
+    uint16_t params[PARAM_COUNT] = {0, 0};
+    int32_t mask = -1;
+    unsigned hold = 1;
+
+    unsigned counter = 0;
+    int16_t held = 0;
+};
+
+// chain of inserts, processed in the order given
+template<typename... Inserts>
+class InsertChain;
+
+template<>
+class InsertChain<> {
+public:
+    static constexpr unsigned PARAM_COUNT = 0;
+
+    static const char *param_name(unsigned) { return "?"; }
+    uint16_t get_param(unsigned) const { return 0; }
+    void set_param(unsigned, uint16_t) {}
+    void process(int16_t *, size_t) {}
+};
+
+template<typename First, typename... Rest>
+class InsertChain<First, Rest...> {
+public:
+    static constexpr unsigned PARAM_COUNT =
+        First::PARAM_COUNT + InsertChain<Rest...>::PARAM_COUNT;
+
+    // parameters of all inserts, numbered in chain order
+    static const char *param_name(unsigned idx) {
+        return idx < First::PARAM_COUNT
+            ? First::param_name(idx)
+            : InsertChain<Rest...>::param_name(idx - First::PARAM_COUNT);
+    }
+
+    uint16_t get_param(unsigned idx) const {
+        return idx < First::PARAM_COUNT
+            ? first.get_param(idx)
+            : rest.get_param(idx - First::PARAM_COUNT);
+    }
+
+    void set_param(unsigned idx, uint16_t value) {
+        if (idx < First::PARAM_COUNT)
+            first.set_param(idx, value);
+        else
+            rest.set_param(idx - First::PARAM_COUNT, value);
+    }
+
+    DSP_HOT void process(int16_t *buf, size_t size) {
+        if (first.active()) first.process(buf, size);
+        rest.process(buf, size);
+    }
+
+protected:
+    First first;
+    InsertChain<Rest...> rest;
+};
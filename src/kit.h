@@ -0,0 +1,140 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <type_traits>
+
+#include "peaks-drums.h"
+
+// Drum kit assembled at compile time, the same way InsertChain assembles the
+// inserts. Kit<Voices...> holds one instance of each voice, in mixer channel
+// order, and dispatches by voice index. Everything unrolls at compile time,
+// a voice left out of the kit costs neither code nor memory.
+//
+// A voice has to provide:
+//   static const char *name();
+//   the Params<Voice, N> interface (see peaks-drums.h)
+//   VARIANT_COUNT, static const char *variant_name(unsigned variant);
+//   void set_variant(unsigned variant); // i.e. the open hi-hat
+//   void set_velocity(uint16_t velocity, bool accent);
+//   void Init();
+//   void Render(uint8_t control, int16_t *out, size_t size);
+//   bool finished() const;
+//   void Choke(); // silences the voice at once, no fade
+
+// voices of the kit. Builds may define their own list
+#ifndef LITTLEBEAT_KIT
+#define LITTLEBEAT_KIT peaks::BassDrum, peaks::KickDrum, peaks::SnareDrum, \
+                       peaks::HighHat, peaks::FmDrum, peaks::Clap
+#endif
+
+template<typename... Voices>
+class Kit;
+
+template<>
+class Kit<> {
+public:
+    static constexpr unsigned VOICE_COUNT = 0;
+
+    template<typename Voice>
+    static constexpr unsigned index_of() { return 0; }
+
+    static const char *name(unsigned) { return "?"; }
+    static unsigned param_count(unsigned) { return 0; }
+    static const char *param_name(unsigned, unsigned) { return "?"; }
+    static unsigned variant_count(unsigned) { return 0; }
+    static const char *variant_name(unsigned, unsigned) { return nullptr; }
+    uint16_t get_param(unsigned, unsigned) const { return 0; }
+    void set_param(unsigned, unsigned, uint16_t) {}
+    void set_variant(unsigned, unsigned) {}
+    void set_velocity(unsigned, uint16_t, bool) {}
+
+    template<typename Visitor>
+    void visit(Visitor &, unsigned) {}
+};
+
+template<typename First, typename... Rest>
+class Kit<First, Rest...> {
+public:
+    static constexpr unsigned VOICE_COUNT = 1 + Kit<Rest...>::VOICE_COUNT;
+
+    // index of the first voice of the given type, VOICE_COUNT if there is
+    // none in the kit
+    template<typename Voice>
+    static constexpr unsigned index_of() {
+        return std::is_same<Voice, First>::value
+            ? 0
+            : 1 + Kit<Rest...>::template index_of<Voice>();
+    }
+
+    static const char *name(unsigned idx) {
+        return idx == 0 ? First::name() : Kit<Rest...>::name(idx - 1);
+    }
+
+    static unsigned param_count(unsigned idx) {
+        // no ternary, it would odr-use PARAM_COUNT
+        if (idx == 0) return First::PARAM_COUNT;
+        return Kit<Rest...>::param_count(idx - 1);
+    }
+
+    static const char *param_name(unsigned idx, unsigned param) {
+        return idx == 0 ? First::param_name(param)
+                        : Kit<Rest...>::param_name(idx - 1, param);
+    }
+
+    static unsigned variant_count(unsigned idx) {
+        if (idx == 0) return First::VARIANT_COUNT;
+        return Kit<Rest...>::variant_count(idx - 1);
+    }
+
+    // nullptr for voices without variants
+    static const char *variant_name(unsigned idx, unsigned variant) {
+        return idx == 0 ? First::variant_name(variant)
+                        : Kit<Rest...>::variant_name(idx - 1, variant);
+    }
+
+    uint16_t get_param(unsigned idx, unsigned param) const {
+        return idx == 0 ? first.get_param(param)
+                        : rest.get_param(idx - 1, param);
+    }
+
+    void set_param(unsigned idx, unsigned param, uint16_t value) {
+        if (idx == 0)
+            first.set_param(param, value);
+        else
+            rest.set_param(idx - 1, param, value);
+    }
+
+    void set_variant(unsigned idx, unsigned variant) {
+        if (idx == 0)
+            first.set_variant(variant);
+        else
+            rest.set_variant(idx - 1, variant);
+    }
+
+    void set_velocity(unsigned idx, uint16_t velocity, bool accent) {
+        if (idx == 0)
+            first.set_velocity(velocity, accent);
+        else
+            rest.set_velocity(idx - 1, velocity, accent);
+    }
+
+    // calls visitor(voice, index) for every voice, in order
+    template<typename Visitor>
+    DSP_HOT void visit(Visitor &visitor, unsigned idx = 0) {
+        visitor(first, idx);
+        rest.visit(visitor, idx + 1);
+    }
+
+protected:
+    First first;
+    Kit<Rest...> rest;
+};
+
+using DrumKit = Kit<LITTLEBEAT_KIT>;
+
+// kits played at once (multi-timbral mode). Each part has its own instance
+// of the kit, its own MIDI channel and mixer channels
+#ifndef LITTLEBEAT_PARTS
+#define LITTLEBEAT_PARTS 1
+#endif
@@ -0,0 +1,88 @@
+#include "latency.h"
+
+#if LITTLEBEAT_LATENCY
+
+namespace latency {
+
+static uint32_t counts[STAGE_MAX][BUCKET_COUNT];
+static uint32_t max_us[STAGE_MAX];
+static uint64_t total_us[STAGE_MAX];
+static uint32_t hits[STAGE_MAX];
+
+// receive times of the hits in the block on its way to the DMA. A block
+// takes at most as many hits as the event queue holds
+static constexpr unsigned PENDING_MAX = 32;
+static uint32_t pending[PENDING_MAX];
+static unsigned pending_count;
+
+static unsigned bucket(uint32_t us) {
+    unsigned b = 0;
+    for (us >>= 6; us && b < BUCKET_COUNT - 1; us >>= 1) ++b;
+    return b;
+}
+
+static void record(Stage stage, uint32_t us) {
+    ++counts[stage][bucket(us)];
+    if (us > max_us[stage]) max_us[stage] = us;
+    total_us[stage] += us;
+    ++hits[stage];
+}
+
+static const char *stage_name(unsigned stage) {
+    switch (stage) {
+    case APPLIED: return "applied";
+    case QUEUED: return "queued";
+    default: return "?";
+    }
+}
+
+void applied(uint32_t received) {
+    // hits that didn't come from MIDI carry no time
+    if (!received) return;
+
+    record(APPLIED, micros() - received);
+    if (pending_count < PENDING_MAX) pending[pending_count++] = received;
+}
+
+void queued() {
+    uint32_t now = micros();
+    for (unsigned i = 0; i < pending_count; ++i)
+        record(QUEUED, now - pending[i]);
+    pending_count = 0;
+}
+
+void report(Print &out, uint32_t dma_us) {
+    out.printf("latency: DMA holds %u us\n", (unsigned)dma_us);
+
+    for (unsigned stage = 0; stage < STAGE_MAX; ++stage) {
+        if (!hits[stage]) continue;
+        out.printf("  %-8s %u hits, mean %u us, max %u us\n",
+                   stage_name(stage), (unsigned)hits[stage],
+                   (unsigned)(total_us[stage] / hits[stage]),
+                   (unsigned)max_us[stage]);
+
+        for (unsigned b = 0; b < BUCKET_COUNT; ++b) {
+            if (!counts[stage][b]) continue;
+            if (b == BUCKET_COUNT - 1)
+                out.printf("    >= %5u us %u\n", 64u << (b - 1),
+                           (unsigned)counts[stage][b]);
+            else
+                out.printf("    <  %5u us %u\n", 64u << b,
+                           (unsigned)counts[stage][b]);
+        }
+    }
+}
+
+void reset() {
+    for (unsigned stage = 0; stage < STAGE_MAX; ++stage) {
+        for (unsigned b = 0; b < BUCKET_COUNT; ++b) counts[stage][b] = 0;
+        max_us[stage] = 0;
+        total_us[stage] = 0;
+        hits[stage] = 0;
+    }
+    pending_count = 0;
+}
+
+} // namespace latency
+
+#endif
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Latency of the hits from MIDI to audio, as histograms. Build with
+// -DLITTLEBEAT_LATENCY=1 to get them, otherwise the hooks compile to nothing
+#ifndef LITTLEBEAT_LATENCY
+#define LITTLEBEAT_LATENCY 0
+#endif
+
+namespace latency {
+
+// measured from the MIDI message reaching its handler in loop()
+enum Stage {
+    APPLIED = 0, // the audio path starts the hit, see Drummer::start_event
+    QUEUED,      // the first sample of the hit goes out to the I2S DMA
+
+    STAGE_MAX
+};
+
+// buckets of the histograms. Bucket 0 holds up to 64us, each further one
+// twice the span of the last, the last one all beyond 64ms
+constexpr unsigned BUCKET_COUNT = 12;
+
+#if LITTLEBEAT_LATENCY
+
+// a hit started in the block being rendered, received at the given micros()
+void applied(uint32_t received);
+
+// the block rendered last started going out to the DMA
+void queued();
+
+// prints the histograms. The audio the DMA holds ahead of a queued sample
+// adds up to dma_us to what is heard
+void report(Print &out, uint32_t dma_us);
+
+// clears the histograms
+void reset();
+
+#define LATENCY_APPLIED(received) latency::applied(received)
+#define LATENCY_QUEUED() latency::queued()
+
+#else
+
+#define LATENCY_APPLIED(received) do {} while (0)
+#define LATENCY_QUEUED() do {} while (0)
+
+#endif
+
+} // namespace latency
@@ -1,6 +1,5 @@
-#pragma once
-
 #include "lut.h"
+#include "placement.h"
 
 namespace peaks {
 
@@ -58,7 +57,7 @@ const uint16_t lut_svf_damp[] = {
     256,   192,   127,   63,
 };
 
-const uint16_t lut_env_expo[] = {
+const uint16_t lut_env_expo[] LUT_HOT = {
     0,     1035,  2054,  3057,  4045,  5018,  5975,  6918,  7846,  8760,  9659,
     10545, 11416, 12275, 13120, 13952, 14771, 15577, 16371, 17152, 17921, 18679,
     19425, 20159, 20881, 21593, 22294, 22983, 23662, 24331, 24989, 25637, 26274,
@@ -85,7 +84,7 @@ const uint16_t lut_env_expo[] = {
     65495, 65515, 65535, 65535,
 };
 
-const int16_t wav_sine[] = {
+const int16_t wav_sine[] LUT_HOT = {
     0,      201,    402,    603,    804,    1005,   1206,   1406,   1607,
     1808,   2009,   2209,   2410,   2610,   2811,   3011,   3211,   3411,
     3611,   3811,   4011,   4210,   4409,   4608,   4807,   5006,   5205,
@@ -202,7 +201,7 @@ const int16_t wav_sine[] = {
     -1406,  -1206,  -1005,  -804,   -603,   -402,   -201,   0,
 };
 
-const int16_t wav_overdrive[] = {
+const int16_t wav_overdrive[] LUT_HOT = {
     -32767, -32767, -32767, -32767, -32767, -32767, -32767, -32767, -32766,
     -32766, -32766, -32766, -32766, -32766, -32766, -32766, -32766, -32766,
     -32766, -32766, -32766, -32765, -32765, -32765, -32765, -32765, -32765,
@@ -319,7 +318,7 @@ const int16_t wav_overdrive[] = {
     32767,  32767,  32767,  32767,  32767,  32767,  32767,  32767,
 };
 
-const uint32_t lut_oscillator_increments[] = {
+const uint32_t lut_oscillator_increments[] LUT_HOT = {
     594570139,  598878640,  603218361,  607589530,  611992374,  616427123,
     620894008,  625393262,  629925120,  634489817,  639087591,  643718683,
     648383334,  653081787,  657814287,  662581081,  667382416,  672218544,
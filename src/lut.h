@@ -4,6 +4,8 @@
 
 namespace peaks {
 
+// lut_env_expo, wav_sine, wav_overdrive and lut_oscillator_increments are read
+// per sample and are placed in DRAM (LUT_HOT), the rest stays in flash.
 extern const uint16_t lut_svf_cutoff[];
 extern const uint16_t lut_svf_damp[];
 extern const uint16_t lut_env_expo[];
@@ -3,10 +3,31 @@
 #include <MIDI.h>
 
 #include "drummer.h"
+#include "latency.h"
+#include "midiparser.h"
+#include "notemap.h"
+#include "profile.h"
 #include "ui.h"
 
 MIDI_CREATE_INSTANCE(HardwareSerial, Serial2, midi1);
 
+// raw MIDI over the USB serial port as well, i.e. from a laptop through a
+// serial-to-MIDI bridge. Faster than the 31.25 kbaud DIN port. Off by
+// default: the port also carries the text of the boot log and the
+// reporters below, which the MIDI host would get, and keystrokes from a
+// terminal would be taken for MIDI
+#ifndef LITTLEBEAT_SERIAL_MIDI
+#define LITTLEBEAT_SERIAL_MIDI 0
+#endif
+
+#if LITTLEBEAT_SERIAL_MIDI && (LITTLEBEAT_PROFILE || LITTLEBEAT_LATENCY)
+#warning "serial MIDI shares the USB serial port with the text reports"
+#endif
+
+#ifndef LITTLEBEAT_SERIAL_BAUD
+#define LITTLEBEAT_SERIAL_BAUD 115200
+#endif
+
 #define KEY_TRIGGER_PIN    13
 #define S1_TRIGGER_PIN     12
 #define S2_TRIGGER_PIN     14
@@ -17,7 +38,8 @@ MIDI_CREATE_INSTANCE(HardwareSerial, Serial2, midi1);
 #define OLED_DC_PIN  2
 
 Drummer drummer;
-UI ui(drummer, KEY_TRIGGER_PIN, S1_TRIGGER_PIN, S2_TRIGGER_PIN,
+NoteMap note_map;
+UI ui(drummer, note_map, KEY_TRIGGER_PIN, S1_TRIGGER_PIN, S2_TRIGGER_PIN,
       BACK_TRIGGER_PIN, OLED_RST_PIN, OLED_DC_PIN);
 
 void setup_drums()
@@ -27,65 +49,197 @@ void setup_drums()
 
 constexpr unsigned PERCUSSION_CHANNEL = 10;
 
-constexpr unsigned ACCOUSTIC_BASS_DRUM = 35;
-constexpr unsigned BASS_DRUM1 = 36;
-constexpr unsigned ACCOUSTIC_SNARE = 38;
-constexpr unsigned HAND_CLAP = 39;
-constexpr unsigned ELECTRIC_SNARE = 40;
-constexpr unsigned CLOSED_HIHAT = 42;
-constexpr unsigned OPEN_HIHAT = 46;
+// part each MIDI channel (1-16) plays, -1 if none. Part p listens on
+// PERCUSSION_CHANNEL + p, see setup_parts
+int8_t channel_parts[17];
+
+static_assert(PERCUSSION_CHANNEL + Drummer::PART_COUNT - 1 <= 16,
+              "every part needs a MIDI channel");
+
+void setup_parts()
+{
+    for (unsigned ch = 0; ch <= 16; ++ch) channel_parts[ch] = -1;
+    for (unsigned p = 0; p < Drummer::PART_COUNT; ++p)
+        channel_parts[PERCUSSION_CHANNEL + p] = p;
+}
+
+int channel_part(byte channel)
+{
+    return channel <= 16 ? channel_parts[channel] : -1;
+}
+
+// p-locks from MIDI: the sound controllers CC 70-79 set parameters 0-9 of
+// the voices the next note triggers, for that hit only
+constexpr byte LOCK_CC_FIRST = 70;
+constexpr byte LOCK_CC_LAST  = 79;
+
+// per part
+Drummer::ParamLock pending_locks[Drummer::PART_COUNT][Drummer::LOCK_MAX];
+unsigned pending_lock_count[Drummer::PART_COUNT] = {};
+
+void handleControlChange(byte inChannel, byte inNumber, byte inValue)
+{
+    if (inNumber < LOCK_CC_FIRST || inNumber > LOCK_CC_LAST) return;
+
+    int part = channel_part(inChannel);
+    if (part < 0) return;
+    Drummer::ParamLock *locks = pending_locks[part];
+    unsigned &count = pending_lock_count[part];
+
+    uint8_t param = inNumber - LOCK_CC_FIRST;
+    // 7 bit to the whole 16 bit range
+    uint16_t value = (inValue << 9) | (inValue << 2) | (inValue >> 5);
+
+    // a repeated CC replaces its earlier value
+    unsigned i = 0;
+    while (i < count && locks[i].param != param) ++i;
+    if (i == Drummer::LOCK_MAX) return;
+
+    locks[i] = {param, value};
+    if (i == count) ++count;
+}
 
 void handleNoteOn(byte inChannel, byte inNote, byte inVelocity)
 {
-    switch (inNote) {
-    case ACCOUSTIC_BASS_DRUM:
-        drummer.trigger(Drummer::BASS_DRUM, inVelocity);
-        return;
-    case BASS_DRUM1:
-        drummer.trigger(Drummer::KICK_DRUM, inVelocity);
-        return;
-    case ACCOUSTIC_SNARE:
-        drummer.trigger(Drummer::SNARE, inVelocity);
-        return;
-    case HAND_CLAP:
-        drummer.trigger(Drummer::CLAP, inVelocity);
-        return;
-    case ELECTRIC_SNARE:
-        drummer.trigger(Drummer::FM, inVelocity);
+    // a hit of velocity 0 would choke the voices, see Drummer::TriggerEvent
+    if (!inVelocity) return;
+
+    // the learned note plays right away
+    if (note_map.learning()) {
+        note_map.learn_note(inNote, inVelocity);
+        ui.mark_dirty();
+    }
+
+    int part = channel_part(inChannel);
+    if (part < 0) return;
+
+    // the note map is shared by the parts, its voices are those of the kit
+    unsigned first_voice = part * DrumKit::VOICE_COUNT;
+
+    Drummer::TriggerEvent ev = {};
+    ev.velocity = inVelocity;
+    ev.lock_count = pending_lock_count[part];
+    for (unsigned i = 0; i < pending_lock_count[part]; ++i)
+        ev.locks[i] = pending_locks[part][i];
+    pending_lock_count[part] = 0;
+    ev.received = micros();
+
+    const NoteMap::Zone *zones = note_map.zones(inNote);
+    for (unsigned i = 0; i < NoteMap::LAYER_MAX; ++i) {
+        const NoteMap::Zone &zone = zones[i];
+        if (zone.voice == NoteMap::NONE) break;
+        if (!zone.matches(inVelocity)) continue;
+
+        ev.voice = first_voice + zone.voice;
+        ev.variant = zone.variant;
+        drummer.trigger(ev);
+    }
+}
+
+void handleNoteOff(byte inChannel, byte inNote, byte inVelocity)
+{
+    // nothing... we let the drum play for as long as needed - trigger only
+}
+
+// SysEx commands: F0 7D <command> F7, 7D being the ID for non-commercial use
+constexpr byte SYSEX_ID = 0x7D;
+
+enum SysexCommand {
+    SYSEX_LATENCY_DUMP = 0x01, // prints the latency histograms to Serial
+    SYSEX_LATENCY_RESET,       // clears them
+};
+
+void handleSystemExclusive(byte *data, unsigned size)
+{
+    if (size != 4 || data[1] != SYSEX_ID) return;
+
+    switch (data[2]) {
+#if LITTLEBEAT_LATENCY
+    case SYSEX_LATENCY_DUMP:
+        latency::report(Serial, drummer.get_dma_duration());
         break;
-    case CLOSED_HIHAT:
-        drummer.trigger(Drummer::HIHAT_CLOSED, inVelocity);
+    case SYSEX_LATENCY_RESET:
+        latency::reset();
         break;
-    case OPEN_HIHAT:
-        drummer.trigger(Drummer::HIHAT_OPEN, inVelocity);
+#endif
+    default:
         break;
     }
 }
 
-void handleNoteOff(byte inChannel, byte inNote, byte inVelocity)
+#if LITTLEBEAT_SERIAL_MIDI
+MidiParser serial_midi;
+
+// hands the messages received over USB serial to the MIDI handlers. The UART
+// driver buffers the bytes from its interrupt, this only takes those that
+// arrived so far
+void read_serial_midi()
 {
-    // nothing... we let the drum play for as long as needed - trigger only
+    for (int n = Serial.available(); n > 0; --n) {
+        int b = Serial.read();
+        if (b < 0 || !serial_midi.parse(b)) continue;
+
+        const MidiParser::Message &msg = serial_midi.message();
+        switch (msg.type) {
+        case MidiParser::NOTE_ON:
+            handleNoteOn(msg.channel, msg.data1, msg.data2);
+            break;
+        case MidiParser::NOTE_OFF:
+            handleNoteOff(msg.channel, msg.data1, msg.data2);
+            break;
+        case MidiParser::CONTROL_CHANGE:
+            handleControlChange(msg.channel, msg.data1, msg.data2);
+            break;
+        case MidiParser::SYSEX:
+            // the parser keeps it until the next one completes
+            handleSystemExclusive(const_cast<byte *>(serial_midi.sysex()),
+                                  serial_midi.sysex_length());
+            break;
+        default:
+            break;
+        }
+    }
 }
+#endif
 
 void setup()
 {
-    Serial.begin(115200);
+    Serial.begin(LITTLEBEAT_SERIAL_BAUD);
     Serial.println("Init");
 
     ui.init();
 
+#if LITTLEBEAT_PROFILE
+    profile::benchmark_reverbs(Serial);
+#endif
+
     drummer.init();
+    note_map.init();
+    setup_parts();
 
     // Init the midi bindings.
     midi1.setHandleNoteOn(handleNoteOn);
     midi1.setHandleNoteOff(handleNoteOff);
-    // TODO: setHandleControlChange for midi mapped drum param settings
-    midi1.begin(10); // we're drums, we're at channel 10
+    midi1.setHandleControlChange(handleControlChange);
+    midi1.setHandleSystemExclusive(handleSystemExclusive);
+    // we're drums, at channel 10 and up, one per part
+    midi1.begin(MIDI_CHANNEL_OMNI);
 }
 
 void loop()
 {
     midi1.read();
+#if LITTLEBEAT_SERIAL_MIDI
+    read_serial_midi();
+#endif
     drummer.update();
     ui.update();
+
+#if LITTLEBEAT_PROFILE
+    static unsigned long last_report = 0;
+    if (millis() - last_report > 5000) {
+        last_report = millis();
+        profile::report(Serial);
+    }
+#endif
 }
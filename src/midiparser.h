@@ -0,0 +1,116 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Byte-wise parser of a raw MIDI stream, for transports the MIDI library
+// doesn't read (i.e. USB serial). Keeps running status, lets real-time
+// bytes through in the middle of other messages and collects short SysEx
+// messages. Feed it whatever bytes arrived, it never blocks.
+class MidiParser {
+public:
+    enum Type : uint8_t {
+        NOTE_OFF         = 0x80,
+        NOTE_ON          = 0x90,
+        POLY_PRESSURE    = 0xA0,
+        CONTROL_CHANGE   = 0xB0,
+        PROGRAM_CHANGE   = 0xC0,
+        CHANNEL_PRESSURE = 0xD0,
+        PITCH_BEND       = 0xE0,
+        SYSEX            = 0xF0, // see sysex()
+        // 0xF8 - 0xFF are the real-time messages, reported as is
+    };
+
+    struct Message {
+        uint8_t type;    // see Type
+        uint8_t channel; // 1-16, 0 for system messages
+        uint8_t data1;
+        uint8_t data2;
+    };
+
+    // longest SysEx kept, including the 0xF0 and 0xF7 framing bytes. Longer
+    // ones are dropped
+    static constexpr unsigned SYSEX_MAX = 32;
+
+    /** takes the next byte of the stream. True if it completed a message,
+        see message() */
+    bool parse(byte b) {
+        // real-time: a single byte, even within another message
+        if (b >= 0xF8) {
+            msg = {b, 0, 0, 0};
+            return true;
+        }
+
+        if (b == 0xF0) {
+            running = 0;
+            sysex_len = 0;
+            in_sysex = true;
+            append_sysex(b);
+            return false;
+        }
+
+        if (b == 0xF7) {
+            if (!in_sysex) return false;
+            in_sysex = false;
+            append_sysex(b);
+            if (sysex_len > SYSEX_MAX) return false;
+            msg = {SYSEX, 0, 0, 0};
+            return true;
+        }
+
+        if (b & 0x80) {
+            // system common messages clear the running status, their data
+            // bytes are skipped with it
+            running = b < 0xF0 ? b : 0;
+            count = 0;
+            in_sysex = false;
+            return false;
+        }
+
+        if (in_sysex) {
+            append_sysex(b);
+            return false;
+        }
+
+        if (!running) return false;
+
+        unsigned length = data_length(running);
+        data[count++] = b;
+        if (count < length) return false;
+        count = 0;
+
+        msg = {uint8_t(running & 0xF0), uint8_t((running & 0x0F) + 1),
+               data[0], uint8_t(length > 1 ? data[1] : 0)};
+        // note on of velocity 0 is a note off, as the MIDI library has it
+        if (msg.type == NOTE_ON && !msg.data2) msg.type = NOTE_OFF;
+        return true;
+    }
+
+    /** the last message parse() completed */
+    const Message &message() const { return msg; }
+
+    /** the last SysEx message, 0xF0 and 0xF7 included */
+    const uint8_t *sysex() const { return sysex_buf; }
+    unsigned sysex_length() const { return sysex_len; }
+
+protected:
+    static unsigned data_length(uint8_t status) {
+        uint8_t type = status & 0xF0;
+        return type == PROGRAM_CHANGE || type == CHANNEL_PRESSURE ? 1 : 2;
+    }
+
+    void append_sysex(byte b) {
+        // counts on past the end, to tell an overlong message
+        if (sysex_len < SYSEX_MAX) sysex_buf[sysex_len] = b;
+        if (sysex_len <= SYSEX_MAX) ++sysex_len;
+    }
+
+    uint8_t running = 0; // status of the current channel message, 0 if none
+    uint8_t data[2] = {};
+    uint8_t count = 0;   // data bytes of the current message so far
+
+    bool in_sysex = false;
+    uint8_t sysex_buf[SYSEX_MAX];
+    unsigned sysex_len = 0;
+
+    Message msg = {};
+};
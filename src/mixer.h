@@ -4,36 +4,91 @@
 
 #include "peaks-drums.h"
 #include "fx.h"
+#include "inserts.h"
+#include "kit.h"
+#include "profile.h"
+
+// reverb engine: 0 builds the comb/allpass Reverb, 4 or 8 a feedback delay
+// network (FdnReverb) with that many lines
+#ifndef REVERB_FDN_LINES
+#define REVERB_FDN_LINES 0
+#endif
 
 class Mixer {
 public:
+    // a channel per voice of the kit, in kit order, for every part
     enum Channel {
-        BASS_DRUM = 0,
-        KICK_DRUM,
-        SNARE,
-        HI_HAT,
-        FM,
-        CLAP,
-
-        CHANNEL_MAX // effectively mixer channel count
+        // effectively mixer channel count
+        CHANNEL_MAX = LITTLEBEAT_PARTS * DrumKit::VOICE_COUNT
+    };
+
+    // effect send buses
+    enum Send {
+        SEND_REVERB = 0,
+        SEND_DELAY,
+
+        SEND_MAX
     };
 
-    // this will definitely clip on more than one sound!
-    static constexpr uint16_t VOL_MAX = 65535 >> 3;
+    // samples mixed in one go. Voices render this many samples into the
+    // channel buffers before mix() is called
+    static constexpr unsigned BLOCK_SIZE = 32;
+
+    // pre-fader peak above which the channel's voice counts as playing
+    static constexpr uint16_t ACTIVITY_THRESHOLD = 64;
+
+    // insert effects of every channel. Drop an insert from the list to
+    // remove it from the build
+    using ChannelInserts = InsertChain<EqInsert, DriveInsert, CrushInsert>;
+
+#if REVERB_FDN_LINES
+    using ReverbEngine = FdnReverb<REVERB_FDN_LINES>;
+#else
+    using ReverbEngine = Reverb;
+#endif
+
+    static constexpr uint16_t VOL_MAX = 65535;
+    // ~-2.5dB. Dense hits are caught by the master bus limiter
+    static constexpr uint16_t VOL_DEFAULT = 49151;
 
     // configurable parameters
     struct ChannelSettings {
-        uint16_t volume = VOL_MAX; // max volume, we shift to avoid clipping
+        uint16_t volume = VOL_DEFAULT;
         uint16_t panning = 32768; // panning, 32768 is center
-        uint16_t fx      = 0;     // fx send
+        uint16_t send[SEND_MAX] = {}; // effect send levels
+    };
+
+    // effect returns and master bus dynamics
+    struct MasterSettings {
+        uint16_t send_return[SEND_MAX] = {65535, 65535}; // return levels
+        uint16_t reverb_width   = 65535; // 0 is the cheaper mono reverb
+        uint16_t delay_time     = 32768; // 0 to ~0.4s
+        uint16_t delay_feedback = 16384;
+        uint16_t comp_threshold = 32768; // 0 to -36dB
+        uint16_t comp_ratio     = 0;     // 1:1 (off) to 20:1
+        uint16_t ceiling        = 65535; // limiter threshold, -12dB to 0dB
     };
 
     // values set by the playback, not directly configurable
     struct ChannelStatus {
-        byte velocity   = 120;  // 0-127 - ie. 7 bit
-        int16_t sample;         // current sample value
+        int16_t block[BLOCK_SIZE]; // current block of samples
     };
 
+    // level meters, taken over several blocks. Post fader, 0-32767
+    struct Meters {
+        uint16_t peak[CHANNEL_MAX];
+        uint16_t rms[CHANNEL_MAX];
+        uint32_t active; // bit per channel, set if the voice was playing
+    };
+
+    static_assert(CHANNEL_MAX <= 32, "Meters::active has a bit per channel");
+
+    Mixer() {
+        // the reverb starts out in mono mode, the other processors' defaults
+        // match the master settings
+        applied.reverb_width = 0;
+    }
+
     void set_volume(Channel chan, uint16_t vol) {
         settings[chan].volume = vol > VOL_MAX ? VOL_MAX : vol;
     }
@@ -47,76 +102,181 @@ public:
     }
 
     static const char *get_channel_name(Channel arg) {
-        switch (arg) {
-        case BASS_DRUM: return "Bass Drum";
-        case KICK_DRUM: return "Kick Drum";
-        case SNARE: return "Snare Drum";
-        case HI_HAT: return "Hi-Hat";
-        case FM: return "FM Drum";
-        case CLAP: return "Clap";
-        default: return "?";
-        }
+        return DrumKit::name(arg % DrumKit::VOICE_COUNT);
     }
 
     ChannelSettings &get_channel_settings(Channel chan) {
         return settings[chan];
     }
 
-    // --- code below is solely used by the playback code ---
+    MasterSettings &get_master_settings() {
+        return master;
+    }
 
-    // sets the current note's velocity
-    void set_velocity(Channel chan, byte vel) {
-        status[chan].velocity = vel > 127 ? 127 : vel;
+    ChannelInserts &get_inserts(Channel chan) {
+        return inserts[chan];
     }
 
-    // sample value accessor
-    int16_t &operator[](Channel chan) {
-        return status[chan].sample;
+    // --- code below is solely used by the playback code ---
+
+    // block of samples for the given channel, filled by the voice
+    int16_t *get_channel_buffer(Channel chan) {
+        return status[chan].block;
     }
 
-    // mixes all samples according to settings and values
-    void mix(int16_t *left, int16_t *right) {
-        int32_t lt = 0, rt = 0;
-        int32_t flt = 0, frt = 0;
+    // mixes the channel buffers according to settings and values.
+    // Writes BLOCK_SIZE interleaved left/right frames of mix bus samples
+    // (see BUS_SHIFT) to out, limited to BUS_FULL_SCALE
+    DSP_HOT void mix(int32_t *out) {
+        int32_t lt[BLOCK_SIZE] = {}, rt[BLOCK_SIZE] = {};
 
         for (unsigned chan = 0; chan < CHANNEL_MAX; ++chan) {
-            // first we mix up the final sample volume
-            int32_t mixed =
-                ( (  status[chan].velocity
-                   * (settings[chan].volume >> 7)) * status[chan].sample
-                ) >> 16;
-            // now we pan it left/right
-            int32_t pan = settings[chan].panning;
+            int16_t *in = status[chan].block;
+
+            {
+                PROFILE_SCOPE(INSERTS);
+                inserts[chan].process(in, BLOCK_SIZE);
+            }
+
+            // volume and panning are fixed for the whole block. Velocity
+            // is up to the voices, see Drummer::trigger
+            uint32_t gain = settings[chan].volume;
+            uint32_t pan  = settings[chan].panning;
+            int32_t gain_l = gain * pan >> 16;
+            int32_t gain_r = gain * (65535 - pan) >> 16;
 
-            int16_t l = mixed * pan >> 16;
-            int16_t r = mixed * (65535 - pan) >> 16;
+            meter(chan, in, gain);
 
             // mix to main
-            lt += l;
-            rt += r;
+            for (unsigned i = 0; i < BLOCK_SIZE; ++i) {
+                lt[i] += in[i] * gain_l >> (16 - BUS_SHIFT);
+                rt[i] += in[i] * gain_r >> (16 - BUS_SHIFT);
+            }
 
-            // mix to fx
-            flt += l * settings[chan].fx >> 16;
-            frt += r * settings[chan].fx >> 16;
+            // post fader sends
+            const uint16_t *send = settings[chan].send;
+            if (send[SEND_REVERB])
+                reverb.add(in, (uint32_t)gain_l * send[SEND_REVERB] >> 16,
+                           (uint32_t)gain_r * send[SEND_REVERB] >> 16);
+            if (send[SEND_DELAY])
+                delay.add(in, (uint32_t)gain_l * send[SEND_DELAY] >> 16,
+                          (uint32_t)gain_r * send[SEND_DELAY] >> 16);
         }
 
-        // process and mix-in the FX
-        int16_t fx_l = peaks::CLIP(flt);
-        int16_t fx_r = peaks::CLIP(frt);
+        ++meter_blocks;
 
-        //echo.Process(fx_l, fx_r);
-        reverb.Process(fx_l, fx_r);
+        update_master();
+
+        // effect returns, skipped while the buses are idle
+        {
+            PROFILE_SCOPE(REVERB);
+            reverb.mix_return(lt, rt, master.send_return[SEND_REVERB]);
+        }
+        {
+            PROFILE_SCOPE(DELAY);
+            delay.mix_return(lt, rt, master.send_return[SEND_DELAY]);
+        }
 
-        *left  = peaks::CLIP(lt + fx_l);
-        *right = peaks::CLIP(rt + fx_r);
+        // master bus dynamics
+        {
+            PROFILE_SCOPE(DYNAMICS);
+            if (compressor.enabled()) compressor.process(lt, rt, BUS_FULL_SCALE);
+            limiter.process(lt, rt);
+        }
+
+        for (unsigned i = 0; i < BLOCK_SIZE; ++i) {
+            out[2 * i]     = bus_clip(lt[i]);
+            out[2 * i + 1] = bus_clip(rt[i]);
+        }
     }
 
+    // fills in the meters accumulated since the last call and restarts them
+    void take_meters(Meters &tgt) {
+        tgt.active = 0;
+        for (unsigned chan = 0; chan < CHANNEL_MAX; ++chan) {
+            tgt.peak[chan] = meter_peak[chan];
+            tgt.rms[chan]  = meter_blocks ? sqrtf(meter_power[chan] / meter_blocks) : 0;
+            if (meter_active & (1UL << chan)) tgt.active |= 1UL << chan;
+
+            meter_peak[chan]  = 0;
+            meter_power[chan] = 0;
+        }
+        meter_active = 0;
+        meter_blocks = 0;
+    }
 
 protected:
+    static int32_t bus_clip(int32_t sample) {
+        if (sample < -BUS_FULL_SCALE) return -BUS_FULL_SCALE;
+        if (sample > BUS_FULL_SCALE) return BUS_FULL_SCALE;
+        return sample;
+    }
+
+    // applies master settings to the effects and dynamics processors, if
+    // they changed. Runs in mix(), so no libm: the setters are inline
+    DSP_HOT void update_master() {
+        if (master.reverb_width != applied.reverb_width)
+            reverb.get_fx().set_width(master.reverb_width);
+        if (master.delay_time != applied.delay_time)
+            delay.get_fx().set_delay(master.delay_time);
+        if (master.delay_feedback != applied.delay_feedback)
+            delay.get_fx().set_feedback(master.delay_feedback);
+
+        if (master.comp_threshold != applied.comp_threshold
+            || master.comp_ratio != applied.comp_ratio)
+        {
+            compressor.set_threshold(36.0f * master.comp_threshold / 65535);
+            compressor.set_ratio(1.0f + 19.0f * master.comp_ratio / 65535);
+        }
+
+        if (master.ceiling != applied.ceiling) {
+            // -12dB to 0dB, linear in dB. 10^(-db/20) = 2^(-db * log2(10)/20)
+            float db = 12.0f * (65535 - master.ceiling) / 65535;
+            limiter.set_threshold(BUS_FULL_SCALE * fast_exp2(-db * 0.16609640f));
+        }
+
+        applied = master;
+    }
+
+    // accumulates peak and power of one channel block. The scan is a tight
+    // loop over the buffer, the fader gain is applied once for the block
+    DSP_HOT void meter(unsigned chan, const int16_t *in, int32_t gain) {
+        int32_t peak = 0;
+        uint32_t power = 0;
+        for (unsigned i = 0; i < BLOCK_SIZE; ++i) {
+            int32_t s = in[i];
+            int32_t a = s < 0 ? -s : s;
+            if (a > peak) peak = a;
+            power += s * s >> 10;
+        }
+
+        if (peak > ACTIVITY_THRESHOLD) meter_active |= 1UL << chan;
+
+        // post fader values
+        peak = peak * gain >> 16;
+        if (peak > meter_peak[chan]) meter_peak[chan] = peak;
+        // mean square of the block, back in sample units squared
+        float g = gain / 65536.0f;
+        meter_power[chan] += power * (1024.0f / BLOCK_SIZE) * g * g;
+    }
+
+    // meter accumulators, reset by take_meters()
+    uint16_t meter_peak[CHANNEL_MAX] = {};
+    float    meter_power[CHANNEL_MAX] = {};
+    uint32_t meter_active = 0;
+    unsigned meter_blocks = 0;
+
 
     ChannelSettings settings[CHANNEL_MAX];
     ChannelStatus   status[CHANNEL_MAX];
+    ChannelInserts  inserts[CHANNEL_MAX];
+
+    MasterSettings master;
+    MasterSettings applied; // master settings the processors are set up with
+
+    Compressor<BLOCK_SIZE> compressor;
+    Limiter<BLOCK_SIZE> limiter;
 
-    Echo echo;
-    Reverb reverb;
+    SendBus<ReverbEngine, BLOCK_SIZE> reverb;
+    SendBus<Echo, BLOCK_SIZE>         delay;
 };
@@ -0,0 +1,217 @@
+#include <Preferences.h>
+
+#include "drummer.h"
+#include "notemap.h"
+
+namespace {
+
+// NVS namespace of the stored settings, kit presets go here as well
+const char *PREFS_NAMESPACE = "littlebeat";
+
+// voice indices of the kit. VOICE_COUNT for voices the build left out,
+// their preset zones are skipped
+constexpr uint8_t BASS_DRUM = DrumKit::index_of<peaks::BassDrum>();
+constexpr uint8_t KICK_DRUM = DrumKit::index_of<peaks::KickDrum>();
+constexpr uint8_t SNARE     = DrumKit::index_of<peaks::SnareDrum>();
+constexpr uint8_t HIHAT     = DrumKit::index_of<peaks::HighHat>();
+constexpr uint8_t FM        = DrumKit::index_of<peaks::FmDrum>();
+constexpr uint8_t CLAP      = DrumKit::index_of<peaks::Clap>();
+
+constexpr uint8_t CLOSED = peaks::HighHat::VARIANT_CLOSED;
+constexpr uint8_t OPEN   = peaks::HighHat::VARIANT_OPEN;
+
+// the accented hits
+constexpr uint8_t ACCENT = ACCENT_THRESHOLD + 1;
+
+struct PresetZone {
+    uint8_t note;
+    NoteMap::Zone zone;
+};
+
+const PresetZone gm_preset[] = {
+    {35, {BASS_DRUM, 0,      1, 127}}, // acoustic bass drum
+    {36, {KICK_DRUM, 0,      1, 127}}, // bass drum 1
+    {38, {SNARE,     0,      1, 127}}, // acoustic snare
+    {39, {CLAP,      0,      1, 127}}, // hand clap
+    {40, {FM,        0,      1, 127}}, // electric snare
+    {41, {FM,        0,      1, 127}}, // low floor tom
+    {42, {HIHAT,     CLOSED, 1, 127}}, // closed hi-hat
+    {43, {FM,        0,      1, 127}}, // high floor tom
+    {44, {HIHAT,     CLOSED, 1, 127}}, // pedal hi-hat
+    {45, {FM,        0,      1, 127}}, // low tom
+    {46, {HIHAT,     OPEN,   1, 127}}, // open hi-hat
+    {47, {FM,        0,      1, 127}}, // low-mid tom
+    {48, {FM,        0,      1, 127}}, // hi-mid tom
+    {50, {FM,        0,      1, 127}}, // high tom
+};
+
+const PresetZone tr8_preset[] = {
+    {36, {BASS_DRUM, 0,      1, ACCENT - 1}}, // BD, the kick drum
+    {36, {KICK_DRUM, 0, ACCENT, 127}},        //     takes the accents
+    {38, {SNARE,     0,      1, 127}},        // SD
+    {39, {CLAP,      0,      1, 127}},        // HC
+    {42, {HIHAT,     CLOSED, 1, 127}},        // CH
+    {43, {FM,        0,      1, 127}},        // LT
+    {46, {HIHAT,     OPEN,   1, 127}},        // OH
+    {47, {FM,        0,      1, 127}},        // MT
+    {50, {FM,        0,      1, 127}},        // HT
+};
+
+} // namespace
+
+const char *NoteMap::layout_name(unsigned layout) {
+    switch (layout) {
+    case LAYOUT_GM:     return "GM";
+    case LAYOUT_TR8:    return "TR-8";
+    case LAYOUT_CUSTOM: return "Custom";
+    default: return "?";
+    }
+}
+
+const char *NoteMap::learn_mode_name(unsigned mode) {
+    switch (mode) {
+    case LEARN_REPLACE: return "Replace";
+    case LEARN_LAYER:   return "Layer";
+    case LEARN_SPLIT:   return "Split";
+    default: return "?";
+    }
+}
+
+void NoteMap::init() {
+    Preferences prefs;
+    prefs.begin(PREFS_NAMESPACE, true);
+    uint8_t stored = prefs.getUChar("layout", LAYOUT_GM);
+    prefs.end();
+
+    apply_preset(LAYOUT_GM);
+    set_layout(stored < LAYOUT_COUNT ? (Layout)stored : LAYOUT_GM);
+    dirty = false;
+}
+
+void NoteMap::save() {
+    if (!dirty) return;
+    dirty = false;
+
+    Preferences prefs;
+    prefs.begin(PREFS_NAMESPACE, false);
+    prefs.putUChar("layout", layout);
+    if (layout == LAYOUT_CUSTOM) {
+        // voice indices are only valid for the kit they were learned with
+        prefs.putUChar("kit", DrumKit::VOICE_COUNT);
+        prefs.putBytes("notes", map, sizeof(map));
+    }
+    prefs.end();
+}
+
+void NoteMap::set_layout(Layout l) {
+    if (l >= LAYOUT_COUNT) return;
+
+    // keep the learned notes before a preset overwrites them
+    if (layout == LAYOUT_CUSTOM) save();
+
+    if (l == LAYOUT_CUSTOM)
+        load_custom();
+    else
+        apply_preset(l);
+
+    layout = l;
+    dirty = true;
+}
+
+void NoteMap::clear() {
+    for (unsigned note = 0; note < NOTE_COUNT; ++note)
+        for (unsigned i = 0; i < LAYER_MAX; ++i)
+            map[note][i] = {NONE, 0, 0, 0};
+}
+
+void NoteMap::apply_preset(Layout l) {
+    const PresetZone *preset = gm_preset;
+    size_t size = sizeof(gm_preset) / sizeof(*gm_preset);
+    if (l == LAYOUT_TR8) {
+        preset = tr8_preset;
+        size = sizeof(tr8_preset) / sizeof(*tr8_preset);
+    }
+
+    clear();
+    for (size_t i = 0; i < size; ++i)
+        if (preset[i].zone.voice < DrumKit::VOICE_COUNT)
+            add_zone(preset[i].note, preset[i].zone);
+}
+
+bool NoteMap::load_custom() {
+    Preferences prefs;
+    prefs.begin(PREFS_NAMESPACE, true);
+
+    bool valid = prefs.getUChar("kit", 0) == DrumKit::VOICE_COUNT
+              && prefs.getBytesLength("notes") == sizeof(map);
+    if (valid) valid = prefs.getBytes("notes", map, sizeof(map)) == sizeof(map);
+
+    prefs.end();
+    return valid;
+}
+
+void NoteMap::learn(unsigned voice, unsigned variant, LearnMode mode) {
+    if (voice >= DrumKit::VOICE_COUNT) return;
+    learn_voice = voice;
+    learn_variant = variant;
+    learn_mode = mode;
+}
+
+void NoteMap::learn_note(byte note, byte velocity) {
+    if (!learning()) return;
+    note &= 0x7F;
+
+    Zone *zones = map[note];
+    Zone zone = {learn_voice, learn_variant, 1, 127};
+
+    switch (learn_mode) {
+    case LEARN_REPLACE:
+        while (zones[0].voice != NONE) remove_zone(note, 0);
+        break;
+    case LEARN_LAYER:
+        // the same voice twice would only double its trigger
+        for (unsigned i = 0; i < LAYER_MAX && zones[i].voice != NONE;)
+            if (zones[i].voice == zone.voice && zones[i].variant == zone.variant)
+                remove_zone(note, i);
+            else
+                ++i;
+        break;
+    case LEARN_SPLIT:
+        // zones above the hit give way to the new one
+        zone.vel_min = velocity ? velocity : 1;
+        for (unsigned i = 0; i < LAYER_MAX && zones[i].voice != NONE;) {
+            if (zones[i].vel_min >= zone.vel_min) {
+                remove_zone(note, i);
+                continue;
+            }
+            if (zones[i].vel_max >= zone.vel_min)
+                zones[i].vel_max = zone.vel_min - 1;
+            ++i;
+        }
+        break;
+    default:
+        break;
+    }
+
+    add_zone(note, zone);
+
+    learned_note = note;
+    layout = LAYOUT_CUSTOM;
+    dirty = true;
+    cancel_learn();
+}
+
+void NoteMap::add_zone(byte note, const Zone &zone) {
+    Zone *zones = map[note & 0x7F];
+
+    unsigned idx = 0;
+    while (idx < LAYER_MAX - 1 && zones[idx].voice != NONE) ++idx;
+    zones[idx] = zone;
+}
+
+void NoteMap::remove_zone(byte note, unsigned idx) {
+    Zone *zones = map[note & 0x7F];
+
+    for (; idx + 1 < LAYER_MAX; ++idx) zones[idx] = zones[idx + 1];
+    zones[LAYER_MAX - 1] = {NONE, 0, 0, 0};
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "kit.h"
+
+// Maps MIDI notes to the voices of the kit. Each note has up to LAYER_MAX
+// zones, a zone triggers one voice (and variant) over a velocity range.
+// Overlapping zones layer voices, disjoint ones split the note by velocity.
+// Lookup is a plain index by note number.
+class NoteMap {
+public:
+    static constexpr unsigned NOTE_COUNT = 128;
+    static constexpr unsigned LAYER_MAX  = 4; // zones per note
+
+    // voice of an unused zone
+    static constexpr uint8_t NONE = 0xFF;
+
+    enum Layout {
+        LAYOUT_GM = 0, // General MIDI percussion
+        LAYOUT_TR8,    // Roland TR-8 instrument notes
+        LAYOUT_CUSTOM, // learned, kept in NVS
+
+        LAYOUT_COUNT
+    };
+
+    // how a learned note combines with the zones it already has
+    enum LearnMode {
+        LEARN_REPLACE = 0, // the voice becomes the only zone of the note
+        LEARN_LAYER,       // the voice plays along over all velocities
+        LEARN_SPLIT,       // the voice takes the velocities from the hit up
+
+        LEARN_MODE_COUNT
+    };
+
+    struct Zone {
+        uint8_t voice;   // kit voice index, NONE if unused
+        uint8_t variant;
+        uint8_t vel_min; // velocity range, inclusive
+        uint8_t vel_max;
+
+        bool matches(byte velocity) const {
+            return velocity >= vel_min && velocity <= vel_max;
+        }
+    };
+
+    static const char *layout_name(unsigned layout);
+    static const char *learn_mode_name(unsigned mode);
+
+    /** loads the layout stored in NVS, General MIDI if there is none */
+    void init();
+
+    /** stores the layout (and the custom map) in NVS if it changed. Writing
+        the flash stalls the CPU for a while, do this from the UI only */
+    void save();
+
+    /** zones of the note, used ones first, NONE terminated if not full */
+    const Zone *zones(byte note) const {
+        return map[note & 0x7F];
+    }
+
+    Layout get_layout() const { return layout; }
+
+    /** switches to a preset. The custom layout is reloaded from NVS, if
+        never stored, the current map becomes the custom one. Leaving the
+        custom layout stores it first */
+    void set_layout(Layout l);
+
+    /** arms learn mode: the next note played gets the given voice */
+    void learn(unsigned voice, unsigned variant, LearnMode mode);
+    void cancel_learn() { learn_voice = NONE; }
+    bool learning() const { return learn_voice != NONE; }
+
+    /** assigns the armed voice to the note and leaves learn mode. Edits
+        turn the current map into the custom layout */
+    void learn_note(byte note, byte velocity);
+
+    /** the last learned note, -1 if none yet */
+    int get_learned_note() const { return learned_note; }
+
+protected:
+    void clear();
+    void apply_preset(Layout l);
+    bool load_custom();
+
+    // adds a zone to the note, replaces the last one if all are used
+    void add_zone(byte note, const Zone &zone);
+    void remove_zone(byte note, unsigned idx);
+
+    Zone map[NOTE_COUNT][LAYER_MAX];
+    Layout layout = LAYOUT_GM;
+    bool dirty = false;
+
+    uint8_t learn_voice = NONE;
+    uint8_t learn_variant = 0;
+    LearnMode learn_mode = LEARN_REPLACE;
+    int learned_note = -1;
+};
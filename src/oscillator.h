@@ -0,0 +1,114 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "dsp.h"
+#include "lut.h"
+#include "placement.h"
+
+namespace peaks {
+
+// Sine oscillator rendering short blocks at a fixed phase increment, shared
+// by the voices that generate tones. The increment changes between blocks
+// only, so the inner loop has no dependency between samples.
+// Partials close to Nyquist fold back as aliasing, so the output fades out
+// above ~0.35 of the sample rate and is silent from Nyquist on.
+class SineOscillator {
+public:
+    enum Quality {
+        QUALITY_TRUNCATE = 0, // table lookup only
+        QUALITY_LINEAR,       // linear interpolation between table entries
+    };
+
+    void Reset(uint32_t phase = 0) {
+        phase_ = phase;
+    }
+
+    void set_quality(Quality quality) {
+        quality_ = quality;
+    }
+
+    uint32_t phase() const {
+        return phase_;
+    }
+
+    // renders size samples, each one at the current phase before advancing
+    DSP_HOT void Render(uint32_t increment, int16_t *out, size_t size) {
+        uint32_t phase = phase_;
+        phase_ += increment * size;
+
+        if (increment >= FADE_START) {
+            RenderFaded(phase, increment, out, size);
+            return;
+        }
+
+        if (quality_ == QUALITY_TRUNCATE) {
+            for (size_t i = 0; i < size; ++i)
+                out[i] = wav_sine[(phase + increment * i) >> 22];
+        } else {
+            for (size_t i = 0; i < size; ++i)
+                out[i] = Interpolate1022(wav_sine, phase + increment * i);
+        }
+    }
+
+protected:
+    static constexpr uint32_t NYQUIST = 1UL << 31;
+    static constexpr uint32_t FADE_START = 1503238554UL; // 0.35 of the rate
+
+    DSP_HOT void RenderFaded(uint32_t phase, uint32_t increment, int16_t *out,
+                             size_t size) {
+        if (increment >= NYQUIST) {
+            memset(out, 0, size * sizeof(*out));
+            return;
+        }
+
+        // Q15, falls linearly from 1 at FADE_START to 0 at Nyquist. The
+        // divisor is rounded up, so the gain stays below 32768 and a full
+        // scale sample can't wrap
+        int32_t gain = (NYQUIST - increment)
+                     / (((NYQUIST - FADE_START) >> 15) + 1);
+        for (size_t i = 0; i < size; ++i)
+            out[i] = Interpolate1022(wav_sine, phase + increment * i) * gain >> 15;
+    }
+
+    uint32_t phase_ = 0;
+    Quality quality_ = QUALITY_LINEAR;
+};
+
+// Source for feedback FM, where the oscillator output modulates its own
+// pitch. The two most recent samples are averaged, a one-zero lowpass that
+// stops the loop from hunting at high feedback, and the feedback fades out
+// as the pitch rises, where its sidebands would alias.
+class FmFeedback {
+public:
+    void Reset() {
+        previous_ = previous2_ = 0;
+    }
+
+    void Push(int16_t sample) {
+        previous2_ = previous_;
+        previous_ = sample;
+    }
+
+    // averaged feedback, scaled for a carrier at the given increment
+    DSP_HOT int32_t Get(uint32_t increment) const {
+        int32_t average = (previous_ + previous2_) >> 1;
+        if (increment <= FADE_START) return average;
+        if (increment >= FADE_END) return 0;
+
+        // Q15, the divisor rounded up as in SineOscillator::RenderFaded
+        int32_t gain = (FADE_END - increment)
+                     / (((FADE_END - FADE_START) >> 15) + 1);
+        return average * gain >> 15;
+    }
+
+protected:
+    // 1/16 to 1/4 of the sample rate
+    static constexpr uint32_t FADE_START = 1UL << 28;
+    static constexpr uint32_t FADE_END   = 1UL << 30;
+
+    int16_t previous_ = 0;
+    int16_t previous2_ = 0;
+};
+
+} // namespace peaks
@@ -0,0 +1,13 @@
+#include "oversampling.h"
+
+namespace peaks {
+
+const int16_t halfband_taps_steep[8] LUT_HOT = {
+    10281, -3051, 1442, -708, 321, -124, 35, -4
+};
+
+const int16_t halfband_taps_relaxed[4] LUT_HOT = {
+    9948, -2266, 565, -55
+};
+
+} // namespace peaks
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "dsp.h"
+#include "lut.h"
+#include "placement.h"
+#include "profile.h"
+
+namespace peaks {
+
+// Odd taps on one side of the half-band lowpass filters (Kaiser windowed
+// sinc, Q15). The even taps of a half-band filter are zero except for the
+// center one, which is one half and becomes a plain delay in the polyphase
+// form below.
+// 31 taps: ~57dB from 0.32 of the oversampled rate, for base <-> 2x
+extern const int16_t halfband_taps_steep[8];
+// 15 taps: ~53dB from 0.375, for 2x <-> 4x, where the signal is already
+// band limited to the lower half
+extern const int16_t halfband_taps_relaxed[4];
+
+// 2x upsampler. Every input sample yields two output samples: the input
+// delayed by P samples and the half-sample interpolation after it
+template<unsigned P>
+class HalfBandUp {
+public:
+    // delay of the output, in samples at the input rate
+    static constexpr unsigned DELAY = P;
+
+    HalfBandUp(const int16_t *taps) : taps(taps) {}
+
+    DSP_HOT void Process(int32_t in, int32_t *out) {
+        const int32_t *x = push(in);
+
+        int32_t odd = 0;
+        for (unsigned k = 0; k < P; ++k)
+            odd += taps[k] * (x[P - 1 - k] + x[P + k]);
+
+        // zero stuffing halves the level, hence the gain of two
+        out[0] = x[P];
+        out[1] = odd >> 14;
+    }
+
+    void Reset() {
+        memset(history, 0, sizeof(history));
+    }
+
+protected:
+    static constexpr unsigned LEN = 2 * P;
+
+    // stores the sample, returns the window where x[j] is the sample
+    // pushed j samples ago. Every sample is stored twice so the window
+    // never wraps
+    DSP_HOT const int32_t *push(int32_t in) {
+        pos = pos ? pos - 1 : LEN - 1;
+        history[pos] = history[pos + LEN] = in;
+        return history + pos;
+    }
+
+    const int16_t *taps;
+    unsigned pos = 0;
+    int32_t history[2 * LEN] = {};
+};
+
+// 2x downsampler, takes two input samples per output sample. Filters out
+// the upper half of the band before dropping every other sample
+template<unsigned P>
+class HalfBandDown {
+public:
+    // delay of the output, in samples at the output rate
+    static constexpr unsigned DELAY = P - 1;
+
+    HalfBandDown(const int16_t *taps) : taps(taps) {}
+
+    DSP_HOT int32_t Process(const int32_t *in) {
+        pos = pos ? pos - 1 : LEN - 1;
+        even[pos] = even[pos + LEN] = in[0];
+        odd[pos]  = odd[pos + LEN]  = in[1];
+
+        const int32_t *e = even + pos;
+        const int32_t *o = odd + pos;
+
+        // center tap is one half, the odd taps fall on the odd samples
+        int32_t acc = e[P - 1] << 14;
+        for (unsigned k = 0; k < P; ++k)
+            acc += taps[k] * (o[P - 1 - k] + o[P + k]);
+
+        return acc >> 15;
+    }
+
+    void Reset() {
+        memset(even, 0, sizeof(even));
+        memset(odd, 0, sizeof(odd));
+    }
+
+protected:
+    static constexpr unsigned LEN = 2 * P;
+
+    const int16_t *taps;
+    unsigned pos = 0;
+    int32_t even[2 * LEN] = {};
+    int32_t odd[2 * LEN] = {};
+};
+
+// wav_overdrive waveshaper. Optionally runs at 2x or 4x the sample rate with
+// half-band filters around it, so the harmonics it adds above Nyquist are
+// filtered out instead of folding back as aliasing. The filters delay the
+// output, see get_delay_halves()
+class Overdrive {
+public:
+    // delay of the filters in half samples at the base rate, the 4x path
+    // delays by a fractional sample: 30 (15 samples) at 2x, 37 at 4x
+    static constexpr unsigned DELAY_HALVES_2X =
+        2 * (HalfBandUp<8>::DELAY + HalfBandDown<8>::DELAY);
+    static constexpr unsigned DELAY_HALVES_4X = DELAY_HALVES_2X
+        + HalfBandUp<4>::DELAY + HalfBandDown<4>::DELAY;
+
+    Overdrive()
+        : up1(halfband_taps_steep), up2(halfband_taps_relaxed),
+          down2(halfband_taps_relaxed), down1(halfband_taps_steep) {}
+
+    // 1 (off), 2 or 4
+    void set_oversampling(unsigned factor) {
+        factor = factor >= 4 ? 4 : factor >= 2 ? 2 : 1;
+        if (factor == oversampling) return;
+
+        oversampling = factor;
+        Reset();
+    }
+
+    // clears the filter history
+    void Reset() {
+        up1.Reset(); up2.Reset(); down2.Reset(); down1.Reset();
+    }
+
+    unsigned get_oversampling() const {
+        return oversampling;
+    }
+
+    // delay of the output, in half samples
+    unsigned get_delay_halves() const {
+        if (oversampling == 4) return DELAY_HALVES_4X;
+        if (oversampling == 2) return DELAY_HALVES_2X;
+        return 0;
+    }
+
+    // mixes the shaped signal into in by amount. Takes and returns 16 bit
+    // samples, in may overshoot a little
+    DSP_HOT int32_t Process(int32_t in, uint16_t amount) {
+        if (oversampling == 1) return Shape(in, amount);
+
+        PROFILE_SCOPE(OVERSAMPLING);
+
+        int32_t x2[2];
+        up1.Process(CLIP(in), x2);
+
+        if (oversampling == 2) {
+            x2[0] = Shape(CLIP(x2[0]), amount);
+            x2[1] = Shape(CLIP(x2[1]), amount);
+            return down1.Process(x2);
+        }
+
+        int32_t x4[4];
+        up2.Process(x2[0], x4);
+        up2.Process(x2[1], x4 + 2);
+        for (unsigned i = 0; i < 4; ++i) x4[i] = Shape(CLIP(x4[i]), amount);
+        x2[0] = down2.Process(x4);
+        x2[1] = down2.Process(x4 + 2);
+        return down1.Process(x2);
+    }
+
+protected:
+    DSP_HOT static int32_t Shape(int32_t in, uint16_t amount) {
+        uint32_t phi = (static_cast<int32_t>(in) << 16) + (1L << 31);
+        int16_t overdriven = Interpolate1022(wav_overdrive, phi);
+        return Mix(in, overdriven, amount);
+    }
+
+    unsigned oversampling = 1;
+
+    HalfBandUp<8>   up1;   // base -> 2x
+    HalfBandUp<4>   up2;   // 2x -> 4x
+    HalfBandDown<4> down2; // 4x -> 2x
+    HalfBandDown<8> down1; // 2x -> base
+};
+
+} // namespace peaks
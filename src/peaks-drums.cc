@@ -6,4 +6,12 @@ namespace peaks {
 
 uint32_t Random::rng_state_ = 0x21;
 
+// storage for the parameter tables, indexed at run time
+constexpr ParamDesc<BassDrum>  BassDrum::PARAMS[];
+constexpr ParamDesc<SnareDrum> SnareDrum::PARAMS[];
+constexpr ParamDesc<HighHat>   HighHat::PARAMS[];
+constexpr ParamDesc<FmDrum>    FmDrum::PARAMS[];
+constexpr ParamDesc<Clap>      Clap::PARAMS[];
+constexpr ParamDesc<KickDrum>  KickDrum::PARAMS[];
+
 } // namespace peaks
@@ -2,14 +2,15 @@
 
 #include <Arduino.h>
 
+#include "dsp.h"
+#include "envelope.h"
 #include "lut.h"
+#include "oscillator.h"
+#include "oversampling.h"
+#include "placement.h"
 
 namespace peaks {
 
-// Note: Have to change this if there ever comes a percussion with more
-// parameters
-const uint16_t PARAM_MAX = 6;
-
 // Code in this namespace is largerly based on Peaks source code.
 // https://github.com/pichenettes/eurorack
 
@@ -32,48 +33,7 @@ const uint16_t kHighestNote = 128 * 128;
 const uint16_t kPitchTableStart = 116 * 128;
 const uint16_t kOctave = 128 * 12;
 
-static inline int32_t CLIP(int32_t sample) {
-    if (sample < -32768)
-        return -32768;
-    if (sample > +32767)
-        return +32767;
-    return sample;
-}
-
-inline int16_t Interpolate824(const int16_t *table, uint32_t phase) {
-    int32_t a = table[phase >> 24];
-    int32_t b = table[(phase >> 24) + 1];
-    return a + ((b - a) * static_cast<int32_t>((phase >> 8) & 0xffff) >> 16);
-}
-
-inline uint16_t Interpolate824(const uint16_t *table, uint32_t phase) {
-    uint32_t a = table[phase >> 24];
-    uint32_t b = table[(phase >> 24) + 1];
-    return a + ((b - a) * static_cast<uint32_t>((phase >> 8) & 0xffff) >> 16);
-}
-
-inline int16_t Interpolate824(const uint8_t *table, uint32_t phase) {
-    int32_t a = table[phase >> 24];
-    int32_t b = table[(phase >> 24) + 1];
-    return (a << 8) + ((b - a) * static_cast<int32_t>(phase & 0xffffff) >> 16) -
-           32768;
-}
-
-inline int16_t Interpolate1022(const int16_t* table, uint32_t phase) {
-  int32_t a = table[phase >> 22];
-  int32_t b = table[(phase >> 22) + 1];
-  return a + ((b - a) * static_cast<int32_t>((phase >> 6) & 0xffff) >> 16);
-}
-
-inline int16_t Mix(int16_t a, int16_t b, uint16_t balance) {
-  return (a * (65535 - balance) + b * balance) >> 16;
-}
-
-inline uint16_t Mix(uint16_t a, uint16_t b, uint16_t balance) {
-  return (a * (65535 - balance) + b * balance) >> 16;
-}
-
-inline uint32_t ComputePhaseIncrement(int16_t midi_pitch) {
+DSP_HOT inline uint32_t ComputePhaseIncrement(int16_t midi_pitch) {
     if (midi_pitch >= kHighestNote) {
         midi_pitch = kHighestNote - 1;
     }
@@ -95,57 +55,6 @@ inline uint32_t ComputePhaseIncrement(int16_t midi_pitch) {
     return phase_increment;
 }
 
-class Excitation {
-public:
-    Excitation() {}
-    ~Excitation() {}
-
-    void Init() {
-        delay_ = 0;
-        decay_ = 4093;
-        counter_ = 0;
-        state_ = 0;
-    }
-
-    void set_delay(uint16_t delay) { delay_ = delay; }
-
-    void set_decay(uint16_t decay) { decay_ = decay; }
-
-    void Trigger(int32_t level) {
-        level_   = level;
-        counter_ = delay_ + 1;
-        // this breaks the continuity of things, but without it bass drum
-        // repetitions break
-        state_   = 0;
-    }
-
-    // done - as observed by the counter
-    bool done() { return counter_ == 0; }
-
-    // finished - as in delay passed and excitation went to zero
-    bool finished() {
-        return state_ == 0 && counter_ == 0;
-    }
-
-    inline int32_t Process() {
-        state_ = (state_ * decay_ >> 12);
-        if (counter_ > 0) {
-            --counter_;
-            if (counter_ == 0) {
-                state_ += level_ < 0 ? -level_ : level_;
-            }
-        }
-        return level_ < 0 ? -state_ : state_;
-    }
-
-private:
-    uint32_t delay_;
-    uint32_t decay_;
-    int32_t counter_;
-    int32_t state_;
-    int32_t level_;
-};
-
 // repeated excitation. N counts, then longer decay
 class Repeater {
 public:
@@ -155,6 +64,8 @@ public:
     void Init() {
         decay_ = 3340;
         decay_term_ = 4095;
+        // nothing to repeat until triggered
+        rep_counter_ = UINT32_MAX;
 
         ex_.Init();
         ex_.set_delay(0);
@@ -168,10 +79,18 @@ public:
         ex_.Trigger(level_);
     }
 
-    inline int32_t Process() {
-        // TODO: transition to Decay-Only repeat (via exc.finished())
-        int32_t exc = ex_.Process();
-        if (ex_.finished()) {
+    // silences the pulse and drops the remaining repeats
+    void Stop() {
+        ex_.Stop();
+        rep_counter_ = UINT32_MAX;
+    }
+
+    // renders size samples, size <= Envelope::MAX_BLOCK
+    DSP_HOT void Render(int32_t *out, size_t size) {
+        for (size_t i = 0; i < size;) {
+            i += ex_.RenderSegment(out + i, size - i);
+            if (!ex_.finished() || rep_counter_ > repeats_) continue;
+
             ++rep_counter_;
             if (rep_counter_ == repeats_) {
                 ex_.set_decay(decay_term_);
@@ -180,8 +99,11 @@ public:
                 ex_.Trigger(level_);
             }
         }
+    }
 
-        return exc;
+    // all the repeats and the long decay are over
+    bool finished() const {
+        return ex_.finished() && rep_counter_ > repeats_;
     }
 
     void set_repeats(uint32_t repeats) { repeats_ = repeats; }
@@ -189,10 +111,10 @@ public:
     void set_decay_term(uint32_t decay) { decay_term_ = decay; }
 
 private:
-    Excitation ex_;
+    Envelope ex_;
 
     uint32_t level_;  // level for re-trigger
-    int32_t rep_counter_; // counts down the initial pulses (repeats_ to zero)
+    uint32_t rep_counter_; // counts the finished pulses (zero to repeats_ + 1)
     uint32_t decay_;
     uint32_t decay_term_;
     uint32_t repeats_;
@@ -215,6 +137,12 @@ public:
         mode_ = SVF_MODE_BP;
     }
 
+    // clears the filter state, keeps the settings
+    void Reset() {
+        lp_ = 0;
+        bp_ = 0;
+    }
+
     void set_frequency(int16_t frequency) {
         dirty_ = dirty_ || (frequency_ != frequency);
         frequency_ = frequency;
@@ -231,7 +159,7 @@ public:
 
     void set_mode(SvfMode mode) { mode_ = mode; }
 
-    int32_t Process(int32_t in) {
+    DSP_HOT int32_t Process(int32_t in) {
         if (dirty_) {
             f_ = Interpolate824(lut_svf_cutoff, frequency_ << 17);
             damp_ = Interpolate824(lut_svf_damp, resonance_ << 17);
@@ -254,7 +182,65 @@ public:
         return mode_ == SVF_MODE_BP ? bp_ : (mode_ == SVF_MODE_HP ? hp : lp_);
     }
 
+    // Runs the filter at the double of the sample rate over a block, for
+    // stability at high cutoffs: each input sample is processed twice and
+    // out gets the sum of both outputs. Coefficients are fixed for the block.
+    // Punch is resolved at compile time - only filters without it may pass
+    // false
+    template<bool PUNCH = false>
+    DSP_HOT void Process2x(const int32_t *in, int32_t *out, size_t size) {
+        switch (mode_) {
+        case SVF_MODE_LP: Run2x<SVF_MODE_LP, PUNCH>(in, out, size); break;
+        case SVF_MODE_BP: Run2x<SVF_MODE_BP, PUNCH>(in, out, size); break;
+        case SVF_MODE_HP: Run2x<SVF_MODE_HP, PUNCH>(in, out, size); break;
+        }
+    }
+
 private:
+    template<SvfMode MODE, bool PUNCH>
+    DSP_HOT void Run2x(const int32_t *in, int32_t *out, size_t size) {
+        if (dirty_) {
+            f_ = Interpolate824(lut_svf_cutoff, frequency_ << 17);
+            damp_ = Interpolate824(lut_svf_damp, resonance_ << 17);
+            dirty_ = false;
+        }
+
+        // locals, as out could alias the members
+        const int32_t f = f_;
+        const int32_t damp = damp_;
+        const int32_t punch = punch_;
+        int32_t lp = lp_;
+        int32_t bp = bp_;
+
+        for (size_t i = 0; i < size; ++i) {
+            int32_t x = in[i];
+            int32_t sum = Tick<MODE, PUNCH>(x, f, damp, punch, lp, bp);
+            sum += Tick<MODE, PUNCH>(x, f, damp, punch, lp, bp);
+            out[i] = sum;
+        }
+
+        lp_ = lp;
+        bp_ = bp;
+    }
+
+    template<SvfMode MODE, bool PUNCH>
+    DSP_HOT static inline int32_t Tick(int32_t in, int32_t f, int32_t damp,
+                                       int32_t punch, int32_t &lp, int32_t &bp) {
+        if (PUNCH) {
+            int32_t punch_signal = lp > 4096 ? lp : 2048;
+            f += ((punch_signal >> 4) * punch) >> 9;
+            damp += ((punch_signal - 2048) >> 3);
+        }
+        int32_t notch = in - (bp * damp >> 15);
+        lp += f * bp >> 15;
+        lp = CLIP(lp);
+        int32_t hp = notch - lp;
+        bp += f * hp >> 15;
+        bp = CLIP(bp);
+
+        return MODE == SVF_MODE_BP ? bp : (MODE == SVF_MODE_HP ? hp : lp);
+    }
+
     bool dirty_;
 
     int16_t frequency_;
@@ -293,34 +279,91 @@ private:
     static uint32_t rng_state_;
 };
 
-// ancestor to configurable objects - exposes param names, default values and current values
-class Configurable {
+// describes one parameter of a voice. Parameters are 16 bit values as the
+// UI edits them, the setter maps them to the voice internals
+template<typename Voice>
+struct ParamDesc {
+    const char *name;
+    uint16_t min;
+    uint16_t max;
+    uint16_t def; // default
+    void (Voice::*set)(uint16_t);
+};
+
+// Parameters of a voice, with the same interface the inserts have (see
+// inserts.h). The voice describes them in a constexpr table PARAMS of N
+// ParamDesc entries, this keeps their current values. Getting or setting
+// one parameter is a table lookup, no virtual calls and no copies
+template<typename Voice, unsigned N>
+class Params {
 public:
-    virtual unsigned param_count() const = 0;
+    static constexpr unsigned PARAM_COUNT = N;
 
-    // name getter for specified index
-    virtual const char *param_name(unsigned idx) const = 0;
+    static const char *param_name(unsigned idx) {
+        return idx < N ? Voice::PARAMS[idx].name : "?";
+    }
+
+    uint16_t get_param(unsigned idx) const {
+        return idx < N ? values_[idx] : 0;
+    }
 
-    // fills given array with current parameter values
-    virtual void params_fetch_current(uint16_t *tgt) const = 0;
+    // the value is limited to the range of the parameter
+    void set_param(unsigned idx, uint16_t value) {
+        if (idx >= N) return;
+        const ParamDesc<Voice> &desc = Voice::PARAMS[idx];
+        if (value < desc.min) value = desc.min;
+        if (value > desc.max) value = desc.max;
+        values_[idx] = value;
+        (static_cast<Voice *>(this)->*desc.set)(value);
+    }
+
+    // sets all parameters to their defaults
+    void params_reset() {
+        for (unsigned idx = 0; idx < N; ++idx)
+            set_param(idx, Voice::PARAMS[idx].def);
+    }
 
-    // fills given array with default parameter values
-    virtual void params_fetch_default(uint16_t *tgt) const = 0;
+    // flavours of the voice, i.e. the open hi-hat. Voices that have
+    // variants hide these
+    static constexpr unsigned VARIANT_COUNT = 1;
 
-    // sets new parameter values
-    virtual void params_set(uint16_t *params) = 0;
+    static const char *variant_name(unsigned) { return nullptr; }
+
+    // flavour of the next trigger
+    void set_variant(unsigned) {}
+
+    // dynamics of the next trigger: the velocity through the velocity curve,
+    // 65535 is full, and the accent. The voices scale their trigger levels
+    // and timbre by these when the trigger arrives
+    void set_velocity(uint16_t velocity, bool accent) {
+        velocity_ = velocity;
+        accent_ = accent;
+    }
+
+protected:
+    // depth of the timbre modulations of a hit: full for accents, otherwise
+    // from half to full with the velocity
+    uint16_t accent_depth() const {
+        return accent_ ? 65535 : 32768 + (velocity_ >> 1);
+    }
+
+    uint16_t values_[N];
+    uint16_t velocity_ = 65535;
+    bool accent_ = true;
 };
 
-class BassDrum : public Configurable {
+class BassDrum : public Params<BassDrum, 4> {
 public:
     BassDrum() {}
     ~BassDrum() {}
 
-    constexpr static int16_t  DEFAULT_FREQUENCY = 0;
+    constexpr static uint16_t DEFAULT_FREQUENCY = 32768; // no transposition
     constexpr static uint16_t DEFAULT_DECAY     = 32768;
     constexpr static uint16_t DEFAULT_TONE      = 32768;
     constexpr static uint16_t DEFAULT_PUNCH     = 65535;
 
+    static const char *name() { return "Bass Drum"; }
+
     void Init() {
         pulse_up_.Init();
         pulse_down_.Init();
@@ -339,76 +382,68 @@ public:
         resonator_.set_punch(32768);
         resonator_.set_mode(SVF_MODE_BP);
 
-        set_frequency(DEFAULT_FREQUENCY);
-        set_decay(DEFAULT_DECAY);
-        set_tone(DEFAULT_TONE);
-        set_punch(DEFAULT_PUNCH);
+        params_reset();
 
         lp_state_ = 0;
     }
 
-    int16_t ProcessSingleSample(uint8_t control) {
+    // renders size samples, size <= Envelope::MAX_BLOCK. The trigger
+    // applies to the first one
+    DSP_HOT void Render(uint8_t control, int16_t *out, size_t size) {
         if (control & CONTROL_GATE_RISING) {
-            pulse_up_.Trigger(12 * 32768 * 0.7);
-            pulse_down_.Trigger(-19662 * 0.7);
+            pulse_up_.Trigger(ScaleLevel(PULSE_UP, velocity_));
+            pulse_down_.Trigger(ScaleLevel(PULSE_DOWN, velocity_));
+            pulse_offset_ = ScaleLevel(PULSE_OFFSET, velocity_);
             attack_fm_.Trigger(18000);
         }
-        int32_t excitation = 0;
-        excitation += pulse_up_.Process();
-        excitation += !pulse_down_.done() ? 16384 : 0;
-        excitation += pulse_down_.Process();
-        attack_fm_.Process();
-        resonator_.set_frequency(frequency_ +
-                                 (attack_fm_.done() ? 0 : 17 << 7));
-
-        int32_t resonator_output =
-            (excitation >> 4) + resonator_.Process(excitation);
-        lp_state_ += (resonator_output - lp_state_) * lp_coefficient_ >> 15;
-        int32_t output = lp_state_;
-        output = CLIP(output);
-        return output;
-    }
-
-    /// configurable interface:
-    unsigned param_count() const override { return 4; }
-    const char *param_name(unsigned arg) const override {
-        switch (arg) {
-        case 0: return "Frequency";
-        case 1: return "Punch";
-        case 2: return "Tone";
-        case 3: return "Decay";
-        default: return "?";
-        }
-    }
 
-    void params_fetch_current(uint16_t *tgt) const override {
-        tgt[0] = freq_param + 32768;
-        tgt[1] = punch_param;
-        tgt[2] = tone_param;
-        tgt[3] = decay_param;
+        // the offset of the down pulse and the attack FM last while their
+        // envelopes wait for the delay
+        uint32_t down_waiting = pulse_down_.waiting();
+        uint32_t fm_waiting = attack_fm_.waiting();
+
+        int32_t up[Envelope::MAX_BLOCK];
+        int32_t down[Envelope::MAX_BLOCK];
+        pulse_up_.Render(up, size);
+        pulse_down_.Render(down, size);
+        attack_fm_.Skip(size);
+
+        for (size_t i = 0; i < size; ++i) {
+            int32_t excitation = up[i] + down[i];
+            excitation += i < down_waiting ? pulse_offset_ : 0;
+            resonator_.set_frequency(frequency_ +
+                                     (i < fm_waiting ? 17 << 7 : 0));
+
+            int32_t resonator_output =
+                (excitation >> 4) + resonator_.Process(excitation);
+            lp_state_ += (resonator_output - lp_state_) * lp_coefficient_ >> 15;
+            int32_t output = lp_state_;
+            out[i] = CLIP(output);
+        }
     }
 
-    void params_fetch_default(uint16_t *tgt) const override {
-        tgt[0] = DEFAULT_FREQUENCY;
-        tgt[1] = DEFAULT_PUNCH;
-        tgt[2] = DEFAULT_TONE;
-        tgt[3] = DEFAULT_DECAY;
+    // all excitation is over, only the resonator may still ring
+    bool finished() const {
+        return pulse_up_.finished() && pulse_down_.finished() &&
+               attack_fm_.done();
     }
 
-    void params_set(uint16_t *params) override {
-        set_frequency(params[0] - 32768);
-        set_punch(params[1]);
-        set_tone(params[2]);
-        set_decay(params[3]);
+    // silences the voice, the next trigger starts from rest
+    void Choke() {
+        pulse_up_.Stop();
+        pulse_down_.Stop();
+        attack_fm_.Stop();
+        resonator_.Reset();
+        lp_state_ = 0;
     }
 
-    void set_frequency(int16_t frequency) {
-        freq_param = frequency;
-        frequency_ = (31 << 7) + (static_cast<int32_t>(frequency) * 896 >> 15);
+    // transposition, 32768 is none
+    void set_frequency(uint16_t frequency) {
+        int32_t transposition = frequency - 32768;
+        frequency_ = (31 << 7) + (transposition * 896 >> 15);
     }
 
     void set_decay(uint16_t decay) {
-        decay_param = decay;
         uint32_t scaled;
         uint32_t squared;
         scaled = 65535 - decay;
@@ -418,34 +453,48 @@ public:
     }
 
     void set_tone(uint16_t tone) {
-        tone_param = tone;
         uint32_t coefficient = tone;
         coefficient = coefficient * coefficient >> 16;
         lp_coefficient_ = 512 + (coefficient >> 2) * 3;
     }
 
     void set_punch(uint16_t punch) {
-        punch_param = punch;
-        resonator_.set_punch(punch * punch >> 16);
+        punch_ = punch * punch >> 16;
+        resonator_.set_punch(ScaleLevel(punch_, accent_depth()));
+    }
+
+    // the punch follows right away, it shapes the ringing resonator
+    void set_velocity(uint16_t velocity, bool accent) {
+        Params::set_velocity(velocity, accent);
+        resonator_.set_punch(ScaleLevel(punch_, accent_depth()));
     }
 
+    static constexpr ParamDesc<BassDrum> PARAMS[PARAM_COUNT] = {
+        {"Frequency", 0, 65535, DEFAULT_FREQUENCY, &BassDrum::set_frequency},
+        {"Punch",     0, 65535, DEFAULT_PUNCH,     &BassDrum::set_punch},
+        {"Tone",      0, 65535, DEFAULT_TONE,      &BassDrum::set_tone},
+        {"Decay",     0, 65535, DEFAULT_DECAY,     &BassDrum::set_decay},
+    };
+
 private:
-    Excitation pulse_up_;
-    Excitation pulse_down_;
-    Excitation attack_fm_;
+    Envelope pulse_up_;
+    Envelope pulse_down_;
+    Envelope attack_fm_;
     Svf resonator_;
 
-    int16_t freq_param;
-    uint16_t punch_param;
-    uint16_t tone_param;
-    uint16_t decay_param;
+    // excitation of a full velocity hit
+    static constexpr int32_t PULSE_UP     = 12 * 32768 * 0.7;
+    static constexpr int32_t PULSE_DOWN   = -19662 * 0.7;
+    static constexpr int32_t PULSE_OFFSET = 16384;
 
     int32_t frequency_;
     int32_t lp_coefficient_;
     int32_t lp_state_;
+    int32_t pulse_offset_ = PULSE_OFFSET;
+    uint16_t punch_ = 0;
 };
 
-class SnareDrum : public Configurable {
+class SnareDrum : public Params<SnareDrum, 4> {
   public:
     SnareDrum() {}
     ~SnareDrum() {}
@@ -453,7 +502,9 @@ class SnareDrum : public Configurable {
     constexpr static const uint16_t DEFAULT_TONE      = 0;
     constexpr static const uint16_t DEFAULT_SNAPPY    = 32768;
     constexpr static const uint16_t DEFAULT_DECAY     = 32768;
-    constexpr static const uint16_t DEFAULT_FREQUENCY = 0;
+    constexpr static const uint16_t DEFAULT_FREQUENCY = 32768; // no transposition
+
+    static const char *name() { return "Snare Drum"; }
 
     void Init() {
         excitation_1_up_.Init();
@@ -478,83 +529,78 @@ class SnareDrum : public Configurable {
         noise_.set_resonance(2000);
         noise_.set_mode(SVF_MODE_BP);
 
-        set_tone(DEFAULT_TONE);
-        set_snappy(DEFAULT_SNAPPY);
-        set_decay(DEFAULT_DECAY);
-        set_frequency(DEFAULT_FREQUENCY);
+        params_reset();
     }
 
-    int16_t ProcessSingleSample(uint8_t control) {
+    // renders size samples, size <= Envelope::MAX_BLOCK. The trigger
+    // applies to the first one
+    DSP_HOT void Render(uint8_t control, int16_t *out, size_t size) {
         if (control & CONTROL_GATE_RISING) {
-            excitation_1_up_.Trigger(15 * 32768);
-            excitation_1_down_.Trigger(-1 * 32768);
-            excitation_2_.Trigger(13107);
-            excitation_noise_.Trigger(snappy_);
+            excitation_1_up_.Trigger(ScaleLevel(15 * 32768, velocity_));
+            excitation_1_down_.Trigger(ScaleLevel(-1 * 32768, velocity_));
+            excitation_2_.Trigger(ScaleLevel(13107, velocity_));
+            offset_1_ = ScaleLevel(2621, velocity_);
+            offset_2_ = ScaleLevel(13107, velocity_);
+            // the snares rattle less on soft hits
+            excitation_noise_.Trigger(
+                ScaleLevel(ScaleLevel(snappy_, velocity_), accent_depth()));
         }
 
-        int32_t excitation_1 = 0;
-        excitation_1 += excitation_1_up_.Process();
-        excitation_1 += excitation_1_down_.Process();
-        excitation_1 += !excitation_1_down_.done() ? 2621 : 0;
-
-        int32_t body_1 = body_1_.Process(excitation_1) + (excitation_1 >> 4);
-
-        int32_t excitation_2 = 0;
-        excitation_2 += excitation_2_.Process();
-        excitation_2 += !excitation_2_.done() ? 13107 : 0;
-
-        int32_t body_2 = body_2_.Process(excitation_2) + (excitation_2 >> 4);
-        int32_t noise_sample = Random::GetSample();
-        int32_t noise = noise_.Process(noise_sample);
-        int32_t noise_envelope = excitation_noise_.Process();
-        int32_t sd = 0;
-        sd += body_1 * gain_1_ >> 15;
-        sd += body_2 * gain_2_ >> 15;
-        sd += noise_envelope * noise >> 15;
-        sd = CLIP(sd);
-        return sd;
-    }
-
-    unsigned param_count() const override { return 4; }
-    const char *param_name(unsigned arg) const override {
-        switch (arg) {
-        case 0: return "Frequency";
-        case 1: return "Decay";
-        case 2: return "Tone";
-        case 3: return "Snappy";
-        default: return "?";
+        // the offsets last while the delayed excitations wait
+        uint32_t down_waiting = excitation_1_down_.waiting();
+        uint32_t waiting_2 = excitation_2_.waiting();
+
+        int32_t up[Envelope::MAX_BLOCK];
+        int32_t down[Envelope::MAX_BLOCK];
+        int32_t excitation_2[Envelope::MAX_BLOCK];
+        int32_t noise_envelope[Envelope::MAX_BLOCK];
+        excitation_1_up_.Render(up, size);
+        excitation_1_down_.Render(down, size);
+        excitation_2_.Render(excitation_2, size);
+        excitation_noise_.Render(noise_envelope, size);
+
+        for (size_t i = 0; i < size; ++i) {
+            int32_t excitation_1 = up[i] + down[i];
+            excitation_1 += i < down_waiting ? offset_1_ : 0;
+
+            int32_t body_1 = body_1_.Process(excitation_1) + (excitation_1 >> 4);
+
+            int32_t ex_2 = excitation_2[i];
+            ex_2 += i < waiting_2 ? offset_2_ : 0;
+
+            int32_t body_2 = body_2_.Process(ex_2) + (ex_2 >> 4);
+            int32_t noise_sample = Random::GetSample();
+            int32_t noise = noise_.Process(noise_sample);
+            int32_t sd = 0;
+            sd += body_1 * gain_1_ >> 15;
+            sd += body_2 * gain_2_ >> 15;
+            sd += noise_envelope[i] * noise >> 15;
+            out[i] = CLIP(sd);
         }
     }
 
-    void params_fetch_current(uint16_t *tgt) const override {
-        tgt[0] = freq_param + 32768;
-        tgt[1] = decay_param;
-        tgt[2] = tone_param;
-        tgt[3] = snappy_param;
-    }
-
-    void params_fetch_default(uint16_t *tgt) const override {
-        tgt[0] = DEFAULT_FREQUENCY;
-        tgt[1] = DEFAULT_DECAY;
-        tgt[2] = DEFAULT_TONE;
-        tgt[3] = DEFAULT_SNAPPY;
+    // all excitation is over, only the bodies may still ring
+    bool finished() const {
+        return excitation_1_up_.finished() && excitation_1_down_.finished() &&
+               excitation_2_.finished() && excitation_noise_.finished();
     }
 
-    void params_set(uint16_t *params) override {
-        set_frequency(params[0] - 32768);
-        set_decay(params[1]);
-        set_tone(params[2]);
-        set_snappy(params[3]);
+    void Choke() {
+        excitation_1_up_.Stop();
+        excitation_1_down_.Stop();
+        excitation_2_.Stop();
+        excitation_noise_.Stop();
+        body_1_.Reset();
+        body_2_.Reset();
+        noise_.Reset();
     }
 
     void set_tone(uint16_t tone) {
-        tone_param = tone;
         gain_1_ = 22000 - (tone >> 2);
         gain_2_ = 22000 + (tone >> 2);
     }
 
     void set_snappy(uint16_t snappy) {
-        snappy_param = snappy;
         snappy >>= 1;
         if (snappy >= 28672) {
             snappy = 28672;
@@ -563,43 +609,46 @@ class SnareDrum : public Configurable {
     }
 
     void set_decay(uint16_t decay) {
-        decay_param = decay;
         body_1_.set_resonance(29000 + (decay >> 5));
         body_2_.set_resonance(26500 + (decay >> 5));
         excitation_noise_.set_decay(4092 + (decay >> 14));
     }
 
-    void set_frequency(int16_t frequency) {
-        freq_param = frequency;
+    // transposition, 32768 is none
+    void set_frequency(uint16_t frequency) {
         int16_t base_note = 52 << 7;
-        int32_t transposition = frequency;
+        int32_t transposition = frequency - 32768;
         base_note += transposition * 896 >> 15;
         body_1_.set_frequency(base_note);
         body_2_.set_frequency(base_note + (12 << 7));
         noise_.set_frequency(base_note + (48 << 7));
     }
 
+    static constexpr ParamDesc<SnareDrum> PARAMS[PARAM_COUNT] = {
+        {"Frequency", 0, 65535, DEFAULT_FREQUENCY, &SnareDrum::set_frequency},
+        {"Decay",     0, 65535, DEFAULT_DECAY,     &SnareDrum::set_decay},
+        {"Tone",      0, 65535, DEFAULT_TONE,      &SnareDrum::set_tone},
+        {"Snappy",    0, 65535, DEFAULT_SNAPPY,    &SnareDrum::set_snappy},
+    };
+
 private:
-    Excitation excitation_1_up_;
-    Excitation excitation_1_down_;
-    Excitation excitation_2_;
-    Excitation excitation_noise_;
+    Envelope excitation_1_up_;
+    Envelope excitation_1_down_;
+    Envelope excitation_2_;
+    Envelope excitation_noise_;
     Svf body_1_;
     Svf body_2_;
     Svf noise_;
 
     int32_t gain_1_;
     int32_t gain_2_;
+    int32_t offset_1_ = 2621; // excitations while the delayed ones wait
+    int32_t offset_2_ = 13107;
 
     uint16_t snappy_;
-
-    int16_t freq_param;
-    uint16_t tone_param;
-    uint16_t snappy_param;
-    uint16_t decay_param;
 };
 
-class HighHat : public Configurable {
+class HighHat : public Params<HighHat, 4> {
 public:
     HighHat() {}
     ~HighHat() {}
@@ -609,103 +658,89 @@ public:
     constexpr static uint16_t DEFAULT_CLOSED_DECAY  = 32768;
     constexpr static uint16_t DEFAULT_OPEN_DECAY    = 65535;
 
+    static const char *name() { return "Hi-Hat"; }
+
     void Init() {
         noise_.Init();
         noise_.set_resonance(24000);
         noise_.set_mode(SVF_MODE_BP);
-        // sets both param and frequency
-        set_frequency(DEFAULT_FREQUENCY);
 
         vca_coloration_.Init();
         vca_coloration_.set_resonance(0);
         vca_coloration_.set_mode(SVF_MODE_HP);
-        set_tone(DEFAULT_TONE);
 
         vca_envelope_.Init();
         vca_envelope_.set_delay(0);
-        set_decay(DEFAULT_CLOSED_DECAY);
+
+        open_ = false;
+        params_reset();
     }
 
-    int16_t ProcessSingleSample(uint8_t control) {
+    // renders size samples, size <= Envelope::MAX_BLOCK. The trigger
+    // applies to the first one
+    DSP_HOT void Render(uint8_t control, int16_t *out, size_t size) {
         if (control & CONTROL_GATE_RISING) {
-            vca_envelope_.Trigger(32768 * 15);
+            vca_envelope_.Trigger(ScaleLevel(32768 * 15, velocity_));
         }
 
-        phase_[0] += 48318382;
-        phase_[1] += 71582788;
-        phase_[2] += 37044092;
-        phase_[3] += 54313440;
-        phase_[4] += 66214079;
-        phase_[5] += 93952409;
-
-        int16_t noise = 0;
-        noise += phase_[0] >> 31;
-        noise += phase_[1] >> 31;
-        noise += phase_[2] >> 31;
-        noise += phase_[3] >> 31;
-        noise += phase_[4] >> 31;
-        noise += phase_[5] >> 31;
-        noise <<= 12;
+        int32_t envelope[Envelope::MAX_BLOCK];
+        vca_envelope_.Render(envelope, size);
+
+        int32_t noise[Envelope::MAX_BLOCK] = {};
+        for (size_t i = 0; i < size; ++i) {
+            phase_[0] += 48318382;
+            phase_[1] += 71582788;
+            phase_[2] += 37044092;
+            phase_[3] += 54313440;
+            phase_[4] += 66214079;
+            phase_[5] += 93952409;
+
+            int16_t n = 0;
+            n += phase_[0] >> 31;
+            n += phase_[1] >> 31;
+            n += phase_[2] >> 31;
+            n += phase_[3] >> 31;
+            n += phase_[4] >> 31;
+            n += phase_[5] >> 31;
+            n <<= 12;
+            noise[i] = n;
+        }
 
         // Run the SVF at the double of the original sample rate for stability.
-        int32_t filtered_noise = 0;
-        filtered_noise += noise_.Process(noise);
-        filtered_noise += noise_.Process(noise);
-
-        // The 808-style VCA amplifies only the positive section of the signal.
-        if (filtered_noise < 0) {
-            filtered_noise = 0;
-        } else if (filtered_noise > 32767) {
-            filtered_noise = 32767;
-        }
+        int32_t filtered_noise[Envelope::MAX_BLOCK];
+        noise_.Process2x(noise, filtered_noise, size);
+
+        int32_t vca_noise[Envelope::MAX_BLOCK] = {};
+        for (size_t i = 0; i < size; ++i) {
+            // The 808-style VCA amplifies only the positive section of the signal.
+            int32_t filtered = filtered_noise[i];
+            if (filtered < 0) {
+                filtered = 0;
+            } else if (filtered > 32767) {
+                filtered = 32767;
+            }
 
-        int32_t envelope = vca_envelope_.Process() >> 4;
-        int32_t vca_noise = envelope * filtered_noise >> 14;
-        vca_noise = CLIP(vca_noise);
-        int32_t hh = 0;
-        hh += vca_coloration_.Process(vca_noise);
-        hh += vca_coloration_.Process(vca_noise);
-        hh <<= 1;
-        hh = CLIP(hh);
-        return hh;
-    }
-
-    unsigned param_count() const override { return 4; }
-    const char *param_name(unsigned arg) const override {
-        switch (arg) {
-        case 0: return "Frequency";
-        case 1: return "Tone";
-        case 2: return "Cl. Decay";
-        case 3: return "Op. Decay";
-        default: return "?";
+            int32_t vca = (envelope[i] >> 4) * filtered >> 14;
+            vca_noise[i] = CLIP(vca);
         }
-    }
 
-    void params_fetch_current(uint16_t *tgt) const override {
-        tgt[0] = freq_param;
-        tgt[1] = tone_param;
-        tgt[2] = closed_decay_param;
-        tgt[3] = open_decay_param;
+        int32_t hh[Envelope::MAX_BLOCK];
+        vca_coloration_.Process2x(vca_noise, hh, size);
+        for (size_t i = 0; i < size; ++i)
+            out[i] = CLIP(hh[i] << 1);
     }
 
-    void params_fetch_default(uint16_t *tgt) const override {
-        tgt[0] = DEFAULT_FREQUENCY;
-        tgt[1] = DEFAULT_TONE;
-        tgt[2] = DEFAULT_CLOSED_DECAY;
-        tgt[3] = DEFAULT_OPEN_DECAY;
+    bool finished() const {
+        return vca_envelope_.finished();
     }
 
-    void params_set(uint16_t *params) override {
-        set_frequency(params[0]);
-        set_tone(params[1]);
-
-        closed_decay_param = params[2];
-        open_decay_param   = params[3];
-        set_open(open);
+    void Choke() {
+        vca_envelope_.Stop();
+        noise_.Reset();
+        vca_coloration_.Reset();
     }
 
     void set_frequency(uint16_t frequency) {
-        freq_param = frequency;
         noise_.set_frequency(frequency >> 2);
     }
 
@@ -714,33 +749,55 @@ public:
     }
 
     void set_tone(uint16_t tone) {
-        tone_param = tone;
         vca_coloration_.set_frequency(8192 + (tone >> 3));
     }
 
+    // the decays apply to the closed or the open hat, see set_open
+    void set_closed_decay(uint16_t decay) {
+        if (!open_) set_decay(decay);
+    }
+
+    void set_open_decay(uint16_t decay) {
+        if (open_) set_decay(decay);
+    }
+
     void set_open(bool open) {
-        if (open)
-            set_decay(open_decay_param);
-        else
-            set_decay(closed_decay_param);
+        open_ = open;
+        set_decay(get_param(open ? PARAM_OPEN_DECAY : PARAM_CLOSED_DECAY));
+    }
+
+    enum Variant { VARIANT_CLOSED, VARIANT_OPEN, VARIANT_COUNT };
+
+    static const char *variant_name(unsigned variant) {
+        return variant == VARIANT_OPEN ? "Open" : "Closed";
+    }
+
+    void set_variant(unsigned variant) {
+        set_open(variant == VARIANT_OPEN);
     }
 
+    enum Param { PARAM_FREQUENCY, PARAM_TONE, PARAM_CLOSED_DECAY, PARAM_OPEN_DECAY };
+
+    static constexpr ParamDesc<HighHat> PARAMS[PARAM_COUNT] = {
+        {"Frequency", 0, 65535, DEFAULT_FREQUENCY,    &HighHat::set_frequency},
+        {"Tone",      0, 65535, DEFAULT_TONE,         &HighHat::set_tone},
+        {"Cl. Decay", 0, 65535, DEFAULT_CLOSED_DECAY, &HighHat::set_closed_decay},
+        {"Op. Decay", 0, 65535, DEFAULT_OPEN_DECAY,   &HighHat::set_open_decay},
+    };
+
   private:
     Svf noise_;
     Svf vca_coloration_;
-    Excitation vca_envelope_;
+    Envelope vca_envelope_;
 
     uint32_t phase_[6];
 
-    bool open = false;
-    uint16_t freq_param, tone_param;
-    uint16_t closed_decay_param = DEFAULT_CLOSED_DECAY,
-             open_decay_param = DEFAULT_OPEN_DECAY;
+    bool open_;
 };
 
-class FmDrum : public Configurable {
+class FmDrum : public Params<FmDrum, 4> {
 public:
-    constexpr static int16_t  DEFAULT_FREQUENCY = 31744;
+    constexpr static uint16_t DEFAULT_FREQUENCY = 31744;
     constexpr static uint16_t DEFAULT_FM        = 19456;
     constexpr static uint16_t DEFAULT_DECAY     = 31744;
     constexpr static uint16_t DEFAULT_NOISE     = 51199;
@@ -748,77 +805,85 @@ public:
     FmDrum() { }
     ~FmDrum() { }
 
+    static const char *name() { return "FM Drum"; }
+
     void Init() {
         step_  = 0;
-        phase_ = 0;
-        fm_envelope_phase_ = 0xffffffff;
-        am_envelope_phase_ = 0xffffffff;
-        previous_sample_ = 0;
+        oscillator_.Reset();
+        feedback_.Reset();
 
-        set_frequency(DEFAULT_FREQUENCY);
-        set_fm_amount(DEFAULT_FM);
-        set_decay(DEFAULT_DECAY);
-        set_noise(DEFAULT_NOISE);
+        am_envelope_.Init();
+        am_envelope_.set_floor(ENVELOPE_OFFSET);
+        fm_envelope_.Init();
+        fm_envelope_.set_floor(ENVELOPE_OFFSET);
+        aux_envelope_.Init();
+        aux_envelope_.set_floor(ENVELOPE_OFFSET);
+        aux_envelope_.set_decay_factor(ComputeDecayFactor(4473924));
+
+        params_reset();
     }
 
-    int16_t ProcessSingleSample(uint8_t control) {
+    // renders size samples, size <= Envelope::MAX_BLOCK. The trigger
+    // applies to the first one
+    DSP_HOT void Render(uint8_t control, int16_t *out, size_t size) {
         if (control & CONTROL_GATE_RISING) {
-            fm_envelope_phase_ = 0;
-            am_envelope_phase_ = 0;
-            aux_envelope_phase_ = 0;
-            phase_ = 0x3fff * fm_amount_ >> 16;
+            // soft hits sweep less, and their tails end a bit earlier
+            am_envelope_.Trigger(ENVELOPE_OFFSET +
+                ScaleLevel(ENVELOPE_LEVEL - ENVELOPE_OFFSET, velocity_));
+            fm_envelope_.Trigger(ENVELOPE_OFFSET +
+                ScaleLevel(ENVELOPE_LEVEL - ENVELOPE_OFFSET, accent_depth()));
+            aux_envelope_.Trigger(ENVELOPE_LEVEL);
+            oscillator_.Reset(0x3fff * fm_amount_ >> 16);
             step_ = 0;
         }
 
-        fm_envelope_phase_ += fm_envelope_increment_;
-        if (fm_envelope_phase_ < fm_envelope_increment_) {
-            fm_envelope_phase_ = 0xffffffff;
-        }
-
-        aux_envelope_phase_ += 4473924;
-
-        if (aux_envelope_phase_ < 4473924) {
-            aux_envelope_phase_ = 0xffffffff;
-        }
+        int32_t am_envelope[Envelope::MAX_BLOCK];
+        am_envelope_.Render(am_envelope, size);
+
+        for (size_t i = 0; i < size; ++i) {
+            if ((step_ & 3) == 0) {
+                // the pitch envelopes are sampled every 4th sample
+                uint32_t aux_envelope = RemoveOffset(aux_envelope_.Process(4));
+                uint32_t fm_envelope = RemoveOffset(fm_envelope_.Process(4));
+                phase_increment_ = ComputePhaseIncrement(
+                        frequency_ + \
+                        (fm_envelope * fm_amount_ >> 16) + \
+                        (aux_envelope * aux_envelope_strength_ >> 15) + \
+                        (feedback_.Get(phase_increment_) >> 6));
+
+                // the pitch is fixed for the next 4 samples
+                oscillator_.Render(phase_increment_, tone_, 4);
+            }
 
-        if ((step_ & 3) == 0) {
-            uint32_t aux_envelope = 65535 - Interpolate824(
-                    lut_env_expo, aux_envelope_phase_);
-            uint32_t fm_envelope = 65535 - Interpolate824(
-                    lut_env_expo, fm_envelope_phase_);
-            phase_increment_ = ComputePhaseIncrement(
-                    frequency_ + \
-                    (fm_envelope * fm_amount_ >> 16) + \
-                    (aux_envelope * aux_envelope_strength_ >> 15) + \
-                    (previous_sample_ >> 6));
-        }
+            int16_t mix = tone_[step_ & 3];
+            if (noise_) {
+                mix = Mix(mix, Random::GetSample(), noise_);
+            }
 
-        phase_ += phase_increment_;
+            mix = (((int32_t)mix) * RemoveOffset(am_envelope[i])) >> 16;
 
-        int16_t mix = Interpolate1022(wav_sine, phase_);
-        if (noise_) {
-            mix = Mix(mix, Random::GetSample(), noise_);
-        }
+            if (overdrive_) {
+                // the oversampling filters may overshoot full scale
+                mix = CLIP(overdrive.Process(mix, overdrive_));
+            }
 
-        am_envelope_phase_ += am_envelope_increment_;
-        if (am_envelope_phase_ < am_envelope_increment_) {
-            am_envelope_phase_ = 0xffffffff;
+            step_++;
+            feedback_.Push(mix);
+            out[i] = mix;
         }
+    }
 
-        uint32_t am_envelope =
-            65535 - Interpolate824(lut_env_expo, am_envelope_phase_);
-
-        mix = (((int32_t)mix) * am_envelope) >> 16;
-
-        if (overdrive_) {
-            uint32_t phi = (static_cast<int32_t>(mix) << 16) + (1L << 31);
-            int16_t overdriven = Interpolate1022(wav_overdrive, phi);
-            mix = Mix(mix, overdriven, overdrive_);
-        }
+    // everything goes through the AM envelope
+    bool finished() const {
+        return am_envelope_.finished();
+    }
 
-        step_++;
-        previous_sample_ = mix;
-        return mix;
+    void Choke() {
+        am_envelope_.Stop();
+        fm_envelope_.Stop();
+        aux_envelope_.Stop();
+        feedback_.Reset();
+        overdrive.Reset();
     }
 
     void Morph(uint16_t x, uint16_t y) {
@@ -838,37 +903,13 @@ public:
         }
     }
 
-    unsigned param_count() const override { return 4; }
-
-    const char *param_name(unsigned arg) const override {
-        switch (arg) {
-        case 0: return "Frequency";
-        case 1: return "FM Amount";
-        case 2: return "Decay";
-        case 3: return "Noise";
-        default: return "?";
-        }
-    }
-
-    void params_fetch_current(uint16_t *tgt) const override {
-        tgt[0] = freq_param;
-        tgt[1] = fm_param;
-        tgt[2] = decay_param;
-        tgt[3] = noise_param;
-    }
-
-    void params_fetch_default(uint16_t *tgt) const override {
-        tgt[0] = DEFAULT_FREQUENCY;
-        tgt[1] = DEFAULT_FM;
-        tgt[2] = DEFAULT_DECAY;
-        tgt[3] = DEFAULT_NOISE;
+    // oversampling of the overdrive: 1 (off), 2 or 4
+    void set_oversampling(unsigned factor) {
+        overdrive.set_oversampling(factor);
     }
 
-    void params_set(uint16_t *params) override {
-        set_frequency(params[0]);
-        set_fm_amount(params[1]);
-        set_decay(params[2]);
-        set_noise(params[3]);
+    void set_oscillator_quality(SineOscillator::Quality quality) {
+        oscillator_.set_quality(quality);
     }
 
     inline void set_sd_range(bool sd_range) {
@@ -876,7 +917,6 @@ public:
     }
 
     inline void set_frequency(uint16_t frequency) {
-        freq_param = frequency;
         if (frequency <= 16384) {
             aux_envelope_strength_ = 1024;
         } else if (frequency <= 32768) {
@@ -888,29 +928,42 @@ public:
     }
 
     inline void set_fm_amount(uint16_t fm_amount) {
-        fm_param = fm_amount;
         fm_amount_ = ((fm_amount >> 2) >> 2 * 3);
     }
 
     inline void set_decay(uint16_t decay) {
-        decay_param = decay;
         am_decay_ = 16384 + (decay >> 1);
         fm_decay_ = 8192 + (decay >> 2);
-        am_envelope_increment_ = ComputeEnvelopeIncrement(am_decay_);
-        fm_envelope_increment_ = ComputeEnvelopeIncrement(fm_decay_);
+        am_envelope_.set_decay_factor(
+                ComputeDecayFactor(ComputeEnvelopeIncrement(am_decay_)));
+        fm_envelope_.set_decay_factor(
+                ComputeDecayFactor(ComputeEnvelopeIncrement(fm_decay_)));
     }
 
     inline void set_noise(uint16_t noise) {
-        noise_param = noise;
         uint32_t n = noise;
         noise_ = noise >= 32768 ? ((n - 32768) * (n - 32768) >> 15) : 0;
         noise_ = (noise_ >> 2) * 5;
         overdrive_ = noise <= 32767 ? ((32767 - n) * (32767 - n) >> 14) : 0;
     }
 
+    static constexpr ParamDesc<FmDrum> PARAMS[PARAM_COUNT] = {
+        {"Frequency", 0, 65535, DEFAULT_FREQUENCY, &FmDrum::set_frequency},
+        {"FM Amount", 0, 65535, DEFAULT_FM,        &FmDrum::set_fm_amount},
+        {"Decay",     0, 65535, DEFAULT_DECAY,     &FmDrum::set_decay},
+        {"Noise",     0, 65535, DEFAULT_NOISE,     &FmDrum::set_noise},
+    };
+
 private:
     bool sd_range_;
 
+    // The envelopes follow 65535 - lut_env_expo over a phase advancing by
+    // the increment per sample. That table is (1 - e^-4x) / (1 - e^-4), so
+    // the same curve is an exponential decay from ENVELOPE_LEVEL, less
+    // ENVELOPE_OFFSET, which reaches zero where the phase would end
+    static constexpr int32_t ENVELOPE_LEVEL  = 66757; // 65535 / (1 - e^-4)
+    static constexpr int32_t ENVELOPE_OFFSET = 1222;  // ENVELOPE_LEVEL * e^-4
+
     uint32_t ComputeEnvelopeIncrement(uint16_t decay) {
         // Interpolate the two neighboring values of the env_increments table
         uint32_t a = lut_env_increments[decay >> 8];
@@ -918,30 +971,39 @@ private:
         return a - ((a - b) * (decay & 0xff) >> 8);
     }
 
+    // per sample decay of the envelope for a phase increment
+    static float ComputeDecayFactor(uint32_t increment) {
+        return expf(-4.0f * increment / 4294967296.0f);
+    }
+
+    static inline uint32_t RemoveOffset(int32_t envelope) {
+        int32_t offset = ENVELOPE_OFFSET;
+        return envelope > offset ? envelope - offset : 0;
+    }
+
     uint16_t aux_envelope_strength_;
     uint16_t frequency_;
     uint16_t fm_amount_;
     uint16_t am_decay_;
     uint16_t fm_decay_;
 
-    uint32_t am_envelope_increment_;
-    uint32_t fm_envelope_increment_;
-
     uint16_t noise_;
     uint16_t overdrive_;
-    int16_t previous_sample_;
 
-    uint32_t phase_;
+    SineOscillator oscillator_;
+    FmFeedback feedback_;
+    int16_t tone_[4]; // oscillator output for the current 4 samples
+    Overdrive overdrive;
+
+    Envelope am_envelope_;
+    Envelope fm_envelope_;
+    Envelope aux_envelope_; // fixed decay, pitch drop on low notes
+
     uint32_t step_;
-    uint32_t fm_envelope_phase_;
-    uint32_t am_envelope_phase_;
-    uint32_t aux_envelope_phase_;
     uint32_t phase_increment_;
-
-    uint16_t freq_param, fm_param, decay_param, noise_param;
 };
 
-class Clap : public Configurable {
+class Clap : public Params<Clap, 4> {
 public:
     Clap() {};
     ~Clap() {};
@@ -951,102 +1013,81 @@ public:
     constexpr static uint16_t DEFAULT_FAST_DECAY    = 8960;
     constexpr static uint16_t DEFAULT_LONG_DECAY    = 49151;
 
+    static const char *name() { return "Clap"; }
+
     void Init() {
         vca_envelope_.Init();
         vca_envelope_.set_repeats(3);
 
-        set_fast_decay(DEFAULT_FAST_DECAY);
-        set_long_decay(DEFAULT_LONG_DECAY);
-
         vca_filter_.Init();
-        vca_filter_.set_resonance(1000);
         vca_filter_.set_mode(SVF_MODE_BP);
-        set_frequency(DEFAULT_FREQUENCY);
-        set_resonance(DEFAULT_RESONANCE);
+
+        params_reset();
     }
 
-    int16_t ProcessSingleSample(uint8_t control) {
+    // renders size samples, size <= Envelope::MAX_BLOCK. The trigger
+    // applies to the first one
+    DSP_HOT void Render(uint8_t control, int16_t *out, size_t size) {
         if (control & CONTROL_GATE_RISING) {
             // TODO: Set this properly!
-            vca_envelope_.Trigger(32768 * 13);
+            vca_envelope_.Trigger(ScaleLevel(32768 * 13, velocity_));
         }
 
-        int16_t noise = Random::GetSample();
+        int32_t envelope[Envelope::MAX_BLOCK];
+        vca_envelope_.Render(envelope, size);
 
-        int32_t filtered_noise = 0;
-        filtered_noise += vca_filter_.Process(noise);
-        filtered_noise += vca_filter_.Process(noise);
+        int32_t noise[Envelope::MAX_BLOCK] = {};
+        for (size_t i = 0; i < size; ++i)
+            noise[i] = Random::GetSample();
 
-        int32_t envelope = vca_envelope_.Process() >> 4;
-        int32_t vca_noise = envelope * filtered_noise >> 14;
-
-        vca_noise = CLIP(vca_noise);
-        return vca_noise;
-    }
+        int32_t filtered_noise[Envelope::MAX_BLOCK];
+        vca_filter_.Process2x(noise, filtered_noise, size);
 
-    unsigned param_count() const override { return 4; }
-    const char *param_name(unsigned arg) const override {
-        switch (arg) {
-        case 0: return "Frequency";
-        case 1: return "Resonance";
-        case 2: return "Fast Decay";
-        case 3: return "Long Decay";
-        default: return "?";
+        for (size_t i = 0; i < size; ++i) {
+            int32_t vca_noise = (envelope[i] >> 4) * filtered_noise[i] >> 14;
+            out[i] = CLIP(vca_noise);
         }
     }
 
-    void params_fetch_current(uint16_t *tgt) const override {
-        tgt[0] = freq_param;
-        tgt[1] = resonance_param;
-        tgt[2] = fast_decay_param;
-        tgt[3] = long_decay_param;
+    bool finished() const {
+        return vca_envelope_.finished();
     }
 
-    void params_fetch_default(uint16_t *tgt) const override {
-        tgt[0] = DEFAULT_FREQUENCY;
-        tgt[1] = DEFAULT_RESONANCE;
-        tgt[2] = DEFAULT_FAST_DECAY;
-        tgt[3] = DEFAULT_LONG_DECAY;
-    }
-
-    void params_set(uint16_t *params) override {
-        set_frequency(params[0]);
-        set_resonance(params[1]);
-        set_fast_decay(params[2]);
-        set_long_decay(params[3]);
+    void Choke() {
+        vca_envelope_.Stop();
+        vca_filter_.Reset();
     }
 
     void set_frequency(uint16_t frequency) {
-        freq_param = frequency;
         vca_filter_.set_frequency(frequency >> 2);
     }
 
-    void set_resonance(uint16_t frequency) {
-        resonance_param = frequency;
-        vca_filter_.set_resonance(frequency >> 2);
+    void set_resonance(uint16_t resonance) {
+        vca_filter_.set_resonance(resonance >> 2);
     }
 
     void set_fast_decay(uint16_t decay) {
-        fast_decay_param = decay;
         vca_envelope_.set_decay(3968 + (decay >> 9));
     }
 
     void set_long_decay(uint16_t decay) {
-        long_decay_param = decay;
         vca_envelope_.set_decay_term(4092 + (decay >> 14));
     }
 
+    static constexpr ParamDesc<Clap> PARAMS[PARAM_COUNT] = {
+        {"Frequency",  0, 65535, DEFAULT_FREQUENCY,  &Clap::set_frequency},
+        {"Resonance",  0, 65535, DEFAULT_RESONANCE,  &Clap::set_resonance},
+        {"Fast Decay", 0, 65535, DEFAULT_FAST_DECAY, &Clap::set_fast_decay},
+        {"Long Decay", 0, 65535, DEFAULT_LONG_DECAY, &Clap::set_long_decay},
+    };
+
 private:
     Repeater vca_envelope_;
     Svf vca_filter_;
-
-    uint16_t freq_param, resonance_param;
-    uint16_t fast_decay_param, long_decay_param;
-
 };
 
 /// 909-style kick synth
-class KickDrum : public Configurable {
+class KickDrum : public Params<KickDrum, 6> {
 public:
     KickDrum() {};
     ~KickDrum() {};
@@ -1058,6 +1099,8 @@ public:
     constexpr static uint16_t DEFAULT_OVERDRIVE     = 42384;
     constexpr static uint16_t DEFAULT_TONE_DECAY    = 32767;
 
+    static const char *name() { return "Kick Drum"; }
+
     void Init() {
         tone_envelope_.Init();
         peak_envelope_.Init();
@@ -1070,20 +1113,19 @@ public:
         peak_filter_.set_resonance(36384);
         peak_filter_.set_mode(SVF_MODE_LP);
 
-        set_frequency(DEFAULT_FREQUENCY);
-        set_attack(DEFAULT_ATTACK);
-        set_tone(DEFAULT_TONE);
-        set_decay(DEFAULT_DECAY);
-        set_overdrive(DEFAULT_OVERDRIVE);
-        set_tone_decay(DEFAULT_TONE_DECAY);
+        params_reset();
     }
 
-    int16_t ProcessSingleSample(uint8_t control) {
+    // renders size samples, size <= Envelope::MAX_BLOCK. The trigger
+    // applies to the first one
+    DSP_HOT void Render(uint8_t control, int16_t *out, size_t size) {
         if (control & CONTROL_GATE_RISING) {
-            tone_envelope_.Trigger(32768 * 2);
-            peak_envelope_.Trigger(32768 * 6);
-            ps_envelope_.Trigger(32768);
-            phase_ = 0;
+            // accents click harder and sweep deeper
+            tone_envelope_.Trigger(ScaleLevel(32768 * 2, velocity_));
+            peak_envelope_.Trigger(
+                ScaleLevel(ScaleLevel(32768 * 6, velocity_), accent_depth()));
+            ps_envelope_.Trigger(ScaleLevel(32768, accent_depth()));
+            oscillator_.Reset();
             state_ = 0;
             phase_increment_ = 0;
             tone_excitation_ = 0;
@@ -1091,138 +1133,125 @@ public:
 
         // ---- Noise --------------------------------------
         // we just use excitation directly, noise just added inconsistency here
-        int32_t envelope = peak_envelope_.Process() >> 4;
-
-        int32_t filtered_noise = 0;
-        filtered_noise += peak_filter_.Process(envelope);
-        filtered_noise += peak_filter_.Process(envelope);
-
-        int32_t vca_noise = filtered_noise;
-        vca_noise = vca_noise * attack_param >> 16;
-
-        // ---- Tone ---------------------------------------
-        if ((state_ & 0x03) == 0) {
-            // this makes the tone excitation 4x longer
-            tone_excitation_ = tone_envelope_.Process() >> 4;
-            // ramp up to limit clicking
-            tone_excitation_ = tone_excitation_ * lut_env_expo[state_ < 255 ? state_ : 255] >> 16;
-            pitch_sweep_      = ps_envelope_.Process();
-            phase_increment_ = ComputePhaseIncrement(
-                    frequency_
-                    + (frequency_ * (65535 - tone_decay_) >> 16)
-                    + (tone_decay_ * pitch_sweep_ >> 16));
-        }
-
-        state_++;
-
-        int16_t tone = Interpolate1022(wav_sine, phase_);
+        int32_t peak[Envelope::MAX_BLOCK] = {};
+        peak_envelope_.Render(peak, size);
+        for (size_t i = 0; i < size; ++i)
+            peak[i] >>= 4;
+
+        int32_t filtered_noise[Envelope::MAX_BLOCK];
+        peak_filter_.Process2x(peak, filtered_noise, size);
+
+        for (size_t i = 0; i < size; ++i) {
+            int32_t vca_noise = filtered_noise[i] * attack_ >> 16;
+
+            // ---- Tone ---------------------------------------
+            if ((state_ & 0x03) == 0) {
+                // this makes the tone excitation 4x longer
+                tone_excitation_ = tone_envelope_.Process() >> 4;
+                // ramp up to limit clicking
+                tone_excitation_ = tone_excitation_ * lut_env_expo[state_ < 255 ? state_ : 255] >> 16;
+                pitch_sweep_      = ps_envelope_.Process();
+                phase_increment_ = ComputePhaseIncrement(
+                        frequency_
+                        + (frequency_ * (65535 - tone_decay_) >> 16)
+                        + (tone_decay_ * pitch_sweep_ >> 16));
+
+                // the pitch is fixed for the next 4 samples
+                oscillator_.Render(phase_increment_, tone_, 4);
+            }
 
-        phase_ += phase_increment_;
+            int16_t tone = tone_[state_ & 0x03];
 
-        int32_t vca_tone = tone_excitation_ * tone >> 15;
+            state_++;
 
-        // ---- Mix ----------------------------------------
-        // TODO: Distort the tonal portion when applicable
-        // TODO: Delay for the tone_envelope trigger
-        int32_t mix = vca_noise + vca_tone;
+            int32_t vca_tone = tone_excitation_ * tone >> 15;
 
-        if (overdrive_) {
-            uint32_t phi = (static_cast<int32_t>(mix) << 16) + (1L << 31);
-            int16_t overdriven = Interpolate1022(wav_overdrive, phi);
-            mix = Mix(mix, overdriven, overdrive_);
-        }
+            // ---- Mix ----------------------------------------
+            // TODO: Distort the tonal portion when applicable
+            // TODO: Delay for the tone_envelope trigger
+            int32_t mix = vca_noise + vca_tone;
 
-        mix = CLIP(mix);
-        return mix;
-    }
+            if (overdrive_) {
+                mix = overdrive.Process(mix, overdrive_);
+            }
 
-    unsigned param_count() const override { return 6; }
-    const char *param_name(unsigned arg) const override {
-        switch (arg) {
-        case 0: return "Frequency";
-        case 1: return "Tone";
-        case 2: return "Attack";
-        case 3: return "Decay";
-        case 4: return "Overdrive";
-        case 5: return "Tone Decay";
-        default: return "?";
+            out[i] = CLIP(mix);
         }
     }
 
-    void params_fetch_current(uint16_t *tgt) const override {
-        tgt[0] = freq_param;
-        tgt[1] = tone_param;
-        tgt[2] = attack_param;
-        tgt[3] = decay_param;
-        tgt[4] = overdrive_param;
-        tgt[5] = tone_decay_param;
+    // the pitch sweep alone makes no sound
+    bool finished() const {
+        return tone_envelope_.finished() && peak_envelope_.finished();
     }
 
-    void params_fetch_default(uint16_t *tgt) const override {
-        tgt[0] = DEFAULT_FREQUENCY;
-        tgt[1] = DEFAULT_TONE;
-        tgt[2] = DEFAULT_ATTACK;
-        tgt[3] = DEFAULT_DECAY;
-        tgt[3] = DEFAULT_OVERDRIVE;
-        tgt[3] = DEFAULT_TONE_DECAY;
-    }
-
-    void params_set(uint16_t *params) override {
-        set_frequency(params[0]);
-        set_tone(params[1]);
-        set_attack(params[2]);
-        set_decay(params[3]);
-        set_overdrive(params[4]);
-        set_tone_decay(params[5]);
+    void Choke() {
+        tone_envelope_.Stop();
+        peak_envelope_.Stop();
+        ps_envelope_.Stop();
+        peak_filter_.Reset();
+        overdrive.Reset();
     }
 
     void set_frequency(uint16_t freq) {
-        freq_param = freq;
         frequency_ = (24 << 6) + ((72 << 5) * freq >> 16);
     }
 
     void set_tone(uint16_t tone) {
-        tone_param = tone;
         peak_filter_.set_frequency(tone >> 2);
     }
 
     void set_attack(uint16_t attack) {
-        attack_param = attack;
+        attack_ = attack;
     }
 
     void set_decay(uint16_t decay) {
-        decay_param = decay;
         tone_envelope_.set_decay(4080 + (decay >> 12));
         ps_envelope_.set_decay(4080 + (decay >> 12));
     }
 
     void set_overdrive(uint16_t overdrive) {
-        overdrive_param = overdrive;
-        overdrive_ = overdrive_param;
+        overdrive_ = overdrive;
     }
 
     void set_tone_decay(uint16_t decay) {
-        tone_decay_param = decay;
         tone_decay_ = decay >> 3;
     }
 
+    static constexpr ParamDesc<KickDrum> PARAMS[PARAM_COUNT] = {
+        {"Frequency",  0, 65535, DEFAULT_FREQUENCY,  &KickDrum::set_frequency},
+        {"Tone",       0, 65535, DEFAULT_TONE,       &KickDrum::set_tone},
+        {"Attack",     0, 65535, DEFAULT_ATTACK,     &KickDrum::set_attack},
+        {"Decay",      0, 65535, DEFAULT_DECAY,      &KickDrum::set_decay},
+        {"Overdrive",  0, 65535, DEFAULT_OVERDRIVE,  &KickDrum::set_overdrive},
+        {"Tone Decay", 0, 65535, DEFAULT_TONE_DECAY, &KickDrum::set_tone_decay},
+    };
+
+    // oversampling of the overdrive: 1 (off), 2 or 4
+    void set_oversampling(unsigned factor) {
+        overdrive.set_oversampling(factor);
+    }
+
+    void set_oscillator_quality(SineOscillator::Quality quality) {
+        oscillator_.set_quality(quality);
+    }
+
 private:
-    Excitation tone_envelope_;  // envelope of the tonal part
-    Excitation peak_envelope_; // envelope of the peak part (initial peak click)
-    Excitation ps_envelope_;    // pitch sweep (applies to the tonal part)
+    Envelope tone_envelope_;  // envelope of the tonal part
+    Envelope peak_envelope_; // envelope of the peak part (initial peak click)
+    Envelope ps_envelope_;    // pitch sweep (applies to the tonal part)
     Svf peak_filter_;  // this filters the peak sound with low pass
+    SineOscillator oscillator_;
+    Overdrive overdrive;
 
     // cached
     uint32_t frequency_;
-    uint16_t overdrive_, tone_decay_;
+    uint16_t attack_, overdrive_, tone_decay_;
     int32_t pitch_sweep_;
 
     // these are state variables, not parameters
-    uint32_t phase_, state_, phase_increment_;
+    uint32_t state_, phase_increment_;
     int32_t tone_excitation_;
-
-    uint16_t freq_param, tone_param;
-    uint16_t attack_param, decay_param, overdrive_param, tone_decay_param;
+    int16_t tone_[4]; // oscillator output for the current 4 samples
 };
 
 } // end namespace peaks
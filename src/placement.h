@@ -0,0 +1,17 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Memory placement of the audio render path.
+//
+// By default code and const data stay in flash and are read through the flash
+// cache. The cache is switched off while SPIFFS/NVS writes are running, so any
+// cache miss in the render path stalls it until the write is done. Everything
+// touched per sample is therefore pinned to internal RAM. Build with the
+// placement report (see scripts/placement_report.py) to check what landed where.
+
+// render path code - goes to IRAM
+#define DSP_HOT IRAM_ATTR
+
+// lookup tables read per sample - go to DRAM
+#define LUT_HOT DRAM_ATTR
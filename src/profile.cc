@@ -0,0 +1,136 @@
+#include "profile.h"
+
+#if LITTLEBEAT_PROFILE
+
+#include <new>
+
+#include "fx.h"
+
+namespace profile {
+
+uint32_t cycles[SECTION_MAX];
+uint32_t frames;
+
+static const char *section_name(unsigned sec) {
+    switch (sec) {
+    case VOICES: return "voices";
+    case OVERSAMPLING: return "oversamp.";
+    case INSERTS: return "inserts";
+    case REVERB: return "reverb";
+    case DELAY: return "delay";
+    case DYNAMICS: return "dynamics";
+    default: return "?";
+    }
+}
+
+void report(Print &out) {
+    if (!frames) return;
+
+    uint32_t budget = ESP.getCpuFreqMHz() * 1000000 / SAMPLE_RATE;
+    out.printf("profile: %u frames, budget %u cycles/frame\n",
+               (unsigned)frames, (unsigned)budget);
+
+    for (unsigned sec = 0; sec < SECTION_MAX; ++sec) {
+        uint32_t per_frame = cycles[sec] / frames;
+        out.printf("  %-9s %5u cycles/frame %3u%%\n", section_name(sec),
+                   (unsigned)per_frame, (unsigned)(per_frame * 100 / budget));
+        cycles[sec] = 0;
+    }
+    frames = 0;
+}
+
+static constexpr unsigned BENCH_BLOCK = 32;
+static constexpr unsigned BENCH_BLOCKS = 256;
+
+// echo density is measured over windows of this many samples
+static constexpr unsigned DENSITY_WINDOW = 1024;
+
+// Normalized echo density (Abel & Huang) of a window: the share of samples
+// further than one standard deviation from the mean, relative to the share
+// for gaussian noise. Reaches ~1 once the tail is fully diffuse
+static float echo_density(const float *w, unsigned size) {
+    float mean = 0.0f;
+    for (unsigned i = 0; i < size; ++i) mean += w[i];
+    mean /= size;
+
+    float var = 0.0f;
+    for (unsigned i = 0; i < size; ++i) var += (w[i] - mean) * (w[i] - mean);
+    float sd = sqrtf(var / size);
+    if (sd <= 0.0f) return 0.0f;
+
+    unsigned outside = 0;
+    for (unsigned i = 0; i < size; ++i)
+        if (fabsf(w[i] - mean) > sd) ++outside;
+
+    return (float)outside / size / 0.3173f; // erfc(1/sqrt(2))
+}
+
+template<typename Engine>
+static void benchmark(Print &out, const char *name, uint16_t width) {
+    // the engines are too large for the stack and only live for the test
+    Engine *rev = new (std::nothrow) Engine();
+    float *window = new (std::nothrow) float[DENSITY_WINDOW];
+    if (!rev || !window) {
+        out.printf("%s: out of memory\n", name);
+        delete rev;
+        delete[] window;
+        return;
+    }
+    rev->set_width(width);
+
+    int32_t l[BENCH_BLOCK], r[BENCH_BLOCK];
+
+    // impulse response, density of the windows from ~50ms to ~250ms
+    float density = 0.0f;
+    unsigned windows = 0, filled = 0;
+    for (unsigned b = 0; b < BENCH_BLOCKS + BENCH_BLOCKS / 4; ++b) {
+        for (unsigned i = 0; i < BENCH_BLOCK; ++i)
+            l[i] = r[i] = (b == 0 && i == 0) ? BUS_FULL_SCALE : 0;
+
+        rev->process(l, r, BENCH_BLOCK);
+
+        for (unsigned i = 0; i < BENCH_BLOCK; ++i) {
+            window[filled++] = l[i];
+            if (filled < DENSITY_WINDOW) continue;
+
+            filled = 0;
+            if (b * BENCH_BLOCK >= 2 * DENSITY_WINDOW) {
+                density += echo_density(window, DENSITY_WINDOW);
+                ++windows;
+            }
+        }
+    }
+
+    // cost, on noise so no branch gets an easy path
+    uint32_t seed = 1;
+    uint32_t total = 0;
+    for (unsigned b = 0; b < BENCH_BLOCKS; ++b) {
+        for (unsigned i = 0; i < BENCH_BLOCK; ++i) {
+            seed = seed * 1664525 + 1013904223;
+            l[i] = r[i] = (int32_t)seed >> (8 + 16 - BUS_SHIFT);
+        }
+
+        uint32_t start = ESP.getCycleCount();
+        rev->process(l, r, BENCH_BLOCK);
+        total += ESP.getCycleCount() - start;
+    }
+
+    out.printf("%-14s %5u cycles/frame, echo density %.2f, %u bytes\n", name,
+               (unsigned)(total / (BENCH_BLOCKS * BENCH_BLOCK)),
+               windows ? density / windows : 0.0f, (unsigned)sizeof(Engine));
+
+    delete[] window;
+    delete rev;
+}
+
+void benchmark_reverbs(Print &out) {
+    out.println("reverb benchmark:");
+    benchmark<Reverb>(out, "Reverb mono", 0);
+    benchmark<Reverb>(out, "Reverb stereo", 65535);
+    benchmark<FdnReverb<4>>(out, "FDN 4 lines", 65535);
+    benchmark<FdnReverb<8>>(out, "FDN 8 lines", 65535);
+}
+
+} // namespace profile
+
+#endif
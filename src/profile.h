@@ -0,0 +1,57 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Cycle counts of the DSP stages. Build with -DLITTLEBEAT_PROFILE=1 to get
+// them, otherwise the hooks compile to nothing
+#ifndef LITTLEBEAT_PROFILE
+#define LITTLEBEAT_PROFILE 0
+#endif
+
+namespace profile {
+
+enum Section {
+    VOICES = 0,
+    OVERSAMPLING, // overdrive of the voices, part of VOICES
+    INSERTS,
+    REVERB,
+    DELAY,
+    DYNAMICS,
+
+    SECTION_MAX
+};
+
+#if LITTLEBEAT_PROFILE
+
+extern uint32_t cycles[SECTION_MAX];
+extern uint32_t frames;
+
+// adds the cycles spent until the end of the enclosing scope to a section
+class Scope {
+public:
+    Scope(Section sec) : sec(sec), start(ESP.getCycleCount()) {}
+    ~Scope() { cycles[sec] += ESP.getCycleCount() - start; }
+
+protected:
+    Section sec;
+    uint32_t start;
+};
+
+#define PROFILE_SCOPE(sec) profile::Scope profile_scope(profile::sec)
+#define PROFILE_FRAMES(n) (profile::frames += (n))
+
+// prints cycles per output frame of every section and restarts the counts
+void report(Print &out);
+
+// runs the reverb engines over an impulse and noise, prints their cost in
+// cycles per frame and the echo density of their tails
+void benchmark_reverbs(Print &out);
+
+#else
+
+#define PROFILE_SCOPE(sec) do {} while (0)
+#define PROFILE_FRAMES(n) do {} while (0)
+
+#endif
+
+} // namespace profile
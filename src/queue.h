@@ -0,0 +1,37 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+// Passes events to the audio path without locking or allocating. A fixed
+// ring of N entries, N a power of two, with a single producer (MIDI, UI)
+// and a single consumer (the audio path). Neither side ever waits: a push
+// to a full queue fails and the event is dropped.
+template<typename T, unsigned N>
+class EventQueue {
+public:
+    static_assert(N && (N & (N - 1)) == 0, "N must be a power of two");
+
+    // producer side. False if the queue is full
+    bool push(const T &val) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= N) return false;
+        items[h & (N - 1)] = val;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side. False if the queue is empty
+    bool pop(T &tgt) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) return false;
+        tgt = items[t & (N - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+protected:
+    std::atomic<uint32_t> head{0}; // next slot to write
+    std::atomic<uint32_t> tail{0}; // next slot to read
+    T items[N];
+};
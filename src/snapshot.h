@@ -0,0 +1,40 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+// Publishes a value from the audio path to readers elsewhere (UI) without
+// locking. There is a single writer which never waits. A reader that raced a
+// write simply retries (a seqlock).
+template<typename T>
+class Snapshot {
+public:
+    // writer side
+    void publish(const T &val) {
+        uint32_t s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed); // odd - write in progress
+        std::atomic_thread_fence(std::memory_order_release);
+        value = val;
+        seq.store(s + 2, std::memory_order_release);
+    }
+
+    // reader side. Returns false if nothing was published yet
+    bool read(T &tgt) const {
+        for (;;) {
+            uint32_t s = seq.load(std::memory_order_acquire);
+            if (s & 1) continue;
+            tgt = value;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq.load(std::memory_order_relaxed) == s) return s != 0;
+        }
+    }
+
+    // changes with every publish. Used to tell if a re-read is needed
+    uint32_t version() const {
+        return seq.load(std::memory_order_relaxed);
+    }
+
+protected:
+    std::atomic<uint32_t> seq{0};
+    T value;
+};
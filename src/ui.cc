@@ -1,6 +1,9 @@
+#include <SPI.h>
+
 #include "ui.h"
 #include "peaks-drums.h"
 #include "drummer.h"
+#include "notemap.h"
 
 namespace {
 
@@ -37,6 +40,18 @@ void draw_cursor_horizonal(Display &display, byte x, byte y) {
                      x, y + CURSOR_SIZE);
 }
 
+// part number in the top right corner, when playing more than one kit
+void draw_part(Display &display, unsigned part) {
+    if (Drummer::PART_COUNT < 2) return;
+
+    char str_val[8] = "P";
+    itoa(part + 1, str_val + 1, 10);
+    display.setTextAlignment(TEXT_ALIGN_RIGHT);
+    display.drawString(display.getWidth(), 0, str_val);
+    display.setTextAlignment(TEXT_ALIGN_LEFT);
+}
+
+// value change per encoder detent when turning slowly
 constexpr uint16_t ROTENCODER_STEP = 1024;
 
 /// safely increments the value by N steps
@@ -71,12 +86,66 @@ void safe_decr(int16_t &tgt, uint16_t steps = ROTENCODER_STEP) {
 
 } // namespace
 
+void PagedDisplay::send_command(uint8_t cmd) {
+    digitalWrite(dc, LOW);
+    SPI.transfer(cmd);
+}
+
+void PagedDisplay::display() {
+    for (unsigned page = 0; page < PAGES; ++page) {
+        const uint8_t *cur  = buffer + page * WIDTH;
+        uint8_t       *last = buffer_back + page * WIDTH;
+
+        // find the changed column span of this page
+        unsigned first = 0, end = WIDTH;
+        if (valid) {
+            while (first < WIDTH && cur[first] == last[first]) ++first;
+            if (first == WIDTH) continue; // page unchanged
+            while (cur[end - 1] == last[end - 1]) --end;
+        }
+
+        unsigned col = first + COLUMN_OFFSET;
+        send_command(0xB0 | page);        // page address
+        send_command(0x00 | (col & 0x0F)); // column, low nibble
+        send_command(0x10 | (col >> 4));   // column, high nibble
+
+        // one bulk write per span instead of a transfer per byte
+        digitalWrite(dc, HIGH);
+        SPI.writeBytes(cur + first, end - first);
+        digitalWrite(dc, LOW);
+
+        memcpy(last + first, cur + first, end - first);
+    }
+
+    valid = true;
+}
+
+uint16_t UI::get_step() const {
+    return ROTENCODER_STEP * encoder.acceleration();
+}
+
+unsigned UI::frame_interval() const {
+    // full frame rate up to half load, then stretch the interval linearly
+    // so that at 90% load we only redraw at the slowest rate
+    constexpr uint32_t LOAD_LOW  = 65535 / 2;
+    constexpr uint32_t LOAD_HIGH = 65535 * 9 / 10;
+
+    uint32_t load = drummer.get_load();
+    if (load <= LOAD_LOW) return FRAME_INTERVAL_MS;
+    if (load >= LOAD_HIGH) return FRAME_INTERVAL_MAX_MS;
+
+    return FRAME_INTERVAL_MS
+        + (FRAME_INTERVAL_MAX_MS - FRAME_INTERVAL_MS) * (load - LOAD_LOW)
+            / (LOAD_HIGH - LOAD_LOW);
+}
+
 UIScreen::UIScreen(UI &ui) : ui(ui), display(ui.get_display()) {}
 
 const MainScreen::Choice MainScreen::choices[CHOICE_COUNT] = {
     {ST_PERC,  "Percussions"},
     {ST_PARAM, "Tuning"},
     {ST_MIXER, "Mixer"},
+    {ST_NOTES, "Notes"},
 };
 
 void MainScreen::onKey(KeyType key) {
@@ -98,6 +167,16 @@ void MainScreen::onKey(KeyType key) {
     mark_dirty();
 }
 
+void MainScreen::update() {
+    uint32_t version = ui.get_drummer().get_status_version();
+    if (version != status_version) {
+        status_version = version;
+        mark_dirty();
+    }
+
+    UIScreen::update();
+}
+
 void MainScreen::draw() {
     // display the drum name and all parameters
     uint8_t w = display.getWidth();
@@ -110,14 +189,61 @@ void MainScreen::draw() {
     display.drawLine(0, 12, w, 12);
 
     for (unsigned id = 0; id < CHOICE_COUNT; ++id) {
-        display.drawString(10, 15*(id+1), choices[id].text);
+        display.drawString(10, 15 + 12*id, choices[id].text);
     }
 
-    draw_cursor_horizonal(display, 3, 4 + 15*(index+1));
+    draw_cursor_horizonal(display, 3, 19 + 12*index);
+
+    draw_meters();
 
     display.display();
 }
 
+void MainScreen::draw_meters() {
+    constexpr byte METER_X      = 80; // left edge of the first meter
+    // meters narrow down to fit the channels of all parts
+    constexpr byte METER_PITCH  = Mixer::CHANNEL_MAX <= 6
+                                      ? 8 : 48 / Mixer::CHANNEL_MAX;
+    constexpr byte METER_W      = METER_PITCH > 2 ? METER_PITCH - 2 : 1;
+    constexpr byte METER_TOP    = 15;
+    constexpr byte METER_HEIGHT = 40;
+    constexpr byte ACTIVITY_Y   = METER_TOP + METER_HEIGHT + 3;
+
+    Drummer::Status st;
+    if (!ui.get_drummer().get_status(st)) return;
+
+    // status line: engine load and underrun count
+    char str_val[16];
+    itoa(uint32_t(100) * st.load / 65535, str_val, 10);
+    int sl = strlen(str_val);
+    str_val[sl] = '%';
+    str_val[sl + 1] = 0;
+    display.drawString(64, 0, str_val);
+
+    str_val[0] = 'U';
+    itoa(st.underruns, str_val + 1, 10);
+    display.setTextAlignment(TEXT_ALIGN_RIGHT);
+    display.drawString(display.getWidth(), 0, str_val);
+    display.setTextAlignment(TEXT_ALIGN_LEFT);
+
+    // one vertical meter per channel. Bar is RMS, the line above it the peak
+    for (unsigned chan = 0; chan < Mixer::CHANNEL_MAX; ++chan) {
+        byte x = METER_X + chan * METER_PITCH;
+        byte bottom = METER_TOP + METER_HEIGHT;
+
+        byte rms  = (uint32_t)st.meters.rms[chan]  * METER_HEIGHT / 32768;
+        byte peak = (uint32_t)st.meters.peak[chan] * METER_HEIGHT / 32768;
+
+        display.drawRect(x, METER_TOP, METER_W, METER_HEIGHT);
+        if (rms) display.fillRect(x, bottom - rms, METER_W, rms);
+        if (peak) display.drawHorizontalLine(x, bottom - peak, METER_W);
+
+        // voice activity indicator
+        if (st.meters.active & (1UL << chan))
+            display.fillRect(x, ACTIVITY_Y, METER_W, 3);
+    }
+}
+
 
 void PercussionScreen::onKey(KeyType key) {
     //
@@ -158,14 +284,15 @@ void PercussionScreen::draw() {
 
     // TODO: get all drum params and render them
     // TODO: With two rotencoders we could directly influnence the parameters
-    peaks::Configurable *percussion = ui.get_drummer().get_percussion(index);
-    unsigned pc = percussion->param_count();
-
-    uint16_t params[peaks::PARAM_MAX];
-    percussion->params_fetch_current(params);
+    Drummer &drummer = ui.get_drummer();
+    draw_part(display, drummer.percussion_part(index));
+    unsigned pc = drummer.param_count(index);
 
+    // gauges shrink to fit the voices with more parameters
+    byte pitch = pc > 8 ? 5 : pc > 6 ? 6 : 7;
     for (unsigned id = 0; id < pc; ++id) {
-        draw_gauge(display, 5, 20 + id * 7, 118, 5, params[id]);
+        draw_gauge(display, 5, 16 + id * pitch, 118, pitch - 2,
+                   drummer.get_param(index, id));
     }
 
     display.display();
@@ -174,7 +301,6 @@ void PercussionScreen::draw() {
 
 void ParamScreen::set_percussion(int idx) {
     perc_index = idx;
-    percussion = ui.get_drummer().get_percussion(perc_index);
     name = ui.get_drummer().percussion_name(perc_index);
     index = 0;
 }
@@ -212,18 +338,19 @@ void ParamScreen::onKey(KeyType key) {
         break;
     }
 
+    Drummer &drummer = ui.get_drummer();
+
     if (set_mode) {
-        uint16_t params[peaks::PARAM_MAX];
-        percussion->params_fetch_current(params);
-        if (incr > 0) safe_incr(params[index]);
-        if (incr < 0) safe_decr(params[index]);
-        percussion->params_set(params);
+        uint16_t value = drummer.get_param(perc_index, index);
+        if (incr > 0) safe_incr(value, ui.get_step());
+        if (incr < 0) safe_decr(value, ui.get_step());
+        drummer.set_param(perc_index, index, value);
     } else {
         index += incr;
         if (index < 0) {
             prev_percussion();
-            index = percussion->param_count() - 1;
-        } else if (index >= percussion->param_count()) {
+            index = drummer.param_count(perc_index) - 1;
+        } else if (index >= (int)drummer.param_count(perc_index)) {
             next_percussion();
             index = 0;
         }
@@ -242,19 +369,20 @@ void ParamScreen::draw() {
     display.setFont(ArialMT_Plain_10);
     display.drawString(0, 0, name);
     display.drawLine(0, 12, w, 12);
-    display.drawString(5, 20, percussion->param_name(index));
+    Drummer &drummer = ui.get_drummer();
+    draw_part(display, drummer.percussion_part(perc_index));
+    display.drawString(5, 20, drummer.param_name(perc_index, index));
 
     // render the parameter value
-    uint16_t params[peaks::PARAM_MAX];
-    percussion->params_fetch_current(params);
+    uint16_t value = drummer.get_param(perc_index, index);
 
-    draw_gauge(display, 5, 35, 118, 10, params[index], set_mode);
+    draw_gauge(display, 5, 35, 118, 10, value, set_mode);
 
     char str_val[8];
-    itoa(params[index], str_val, 10);
+    itoa(value, str_val, 10);
     display.drawString(5, 50, str_val);
 
-    itoa(int(100) * params[index] / 65535, str_val, 10);
+    itoa(int(100) * value / 65535, str_val, 10);
     int sl = strlen(str_val);
     str_val[sl] = '%';
     str_val[sl + 1] = 0;
@@ -266,8 +394,9 @@ void ParamScreen::draw() {
     display.display();
 }
 
+// channel pages are followed by a page for the master bus
 MixerScreen::MixerScreen(UI &ui)
-    : UIScreen(ui), idx_max(Mixer::get_channel_count() * SUBCHOICE_COUNT) {}
+    : UIScreen(ui), page_count(Mixer::get_channel_count() + 1) {}
 
 void MixerScreen::onKey(KeyType key) {
     int incr = 0;
@@ -294,41 +423,120 @@ void MixerScreen::onKey(KeyType key) {
         // modify current value
         modify_current_setting(incr);
     } else {
-        index += incr;
+        row += incr;
+
+        // wraparound to the neighbouring pages
+        if (row < 0) {
+            if (--page < 0) page = page_count - 1;
+            row = row_count() - 1;
+        } else if (row >= row_count()) {
+            if (++page >= page_count) page = 0;
+            row = 0;
+        }
 
-        // wraparound
-        if (index < 0) index = idx_max - 1;
-        if (index >= idx_max) index = 0;
+        // keep the cursor row visible
+        if (row < scroll) scroll = row;
+        if (row >= scroll + VISIBLE_ROWS) scroll = row - VISIBLE_ROWS + 1;
     }
 
     // schedule redraw
     mark_dirty();
 }
 
-void MixerScreen::modify_current_setting(int increment) {
-    unsigned channel = index / SUBCHOICE_COUNT;
-    unsigned sub_choice = index % SUBCHOICE_COUNT;
+int MixerScreen::row_count() const {
+    if (page == Mixer::CHANNEL_MAX) return MASTER_ROWS;
+    return CHANNEL_ROWS + Mixer::ChannelInserts::PARAM_COUNT;
+}
 
-    Mixer::ChannelSettings &chs =
-        ui.get_drummer().get_mixer().get_channel_settings(
-            (Mixer::Channel)channel);
+const char *MixerScreen::row_name(int r) const {
+    if (page == Mixer::CHANNEL_MAX) {
+        switch (r) {
+        case 0: return "Rev Return";
+        case 1: return "Rev Width";
+        case 2: return "Dly Return";
+        case 3: return "Dly Time";
+        case 4: return "Dly Fdbk";
+        case 5: return "Comp Thr.";
+        case 6: return "Comp Ratio";
+        case 7: return "Ceiling";
+        default: return "?";
+        }
+    }
 
-    switch (sub_choice) {
-    case 0:
-        if (increment > 0) safe_incr(chs.volume);
-        if (increment < 0) safe_decr(chs.volume);
-        break;
-    case 1:
-        if (increment > 0) safe_incr(chs.panning);
-        if (increment < 0) safe_decr(chs.panning);
-        break;
-    case 2:
-        if (increment > 0) safe_incr(chs.fx);
-        if (increment < 0) safe_decr(chs.fx);
-        break;
+    switch (r) {
+    case 0: return "Volume";
+    case 1: return "Panning";
+    case 2: return "Rev Send";
+    case 3: return "Dly Send";
+    default: return Mixer::ChannelInserts::param_name(r - CHANNEL_ROWS);
     }
 }
 
+uint16_t MixerScreen::get_value(int r) const {
+    Mixer &mixer = ui.get_drummer().get_mixer();
+
+    if (page == Mixer::CHANNEL_MAX) {
+        Mixer::MasterSettings &ms = mixer.get_master_settings();
+        switch (r) {
+        case 0: return ms.send_return[Mixer::SEND_REVERB];
+        case 1: return ms.reverb_width;
+        case 2: return ms.send_return[Mixer::SEND_DELAY];
+        case 3: return ms.delay_time;
+        case 4: return ms.delay_feedback;
+        case 5: return ms.comp_threshold;
+        case 6: return ms.comp_ratio;
+        case 7: return ms.ceiling;
+        default: return 0;
+        }
+    }
+
+    auto chan = (Mixer::Channel)page;
+    Mixer::ChannelSettings &chs = mixer.get_channel_settings(chan);
+    switch (r) {
+    case 0: return chs.volume;
+    case 1: return chs.panning;
+    case 2: return chs.send[Mixer::SEND_REVERB];
+    case 3: return chs.send[Mixer::SEND_DELAY];
+    default: return mixer.get_inserts(chan).get_param(r - CHANNEL_ROWS);
+    }
+}
+
+void MixerScreen::set_value(int r, uint16_t value) {
+    Mixer &mixer = ui.get_drummer().get_mixer();
+
+    if (page == Mixer::CHANNEL_MAX) {
+        Mixer::MasterSettings &ms = mixer.get_master_settings();
+        switch (r) {
+        case 0: ms.send_return[Mixer::SEND_REVERB] = value; break;
+        case 1: ms.reverb_width = value; break;
+        case 2: ms.send_return[Mixer::SEND_DELAY] = value; break;
+        case 3: ms.delay_time = value; break;
+        case 4: ms.delay_feedback = value; break;
+        case 5: ms.comp_threshold = value; break;
+        case 6: ms.comp_ratio = value; break;
+        case 7: ms.ceiling = value; break;
+        }
+        return;
+    }
+
+    auto chan = (Mixer::Channel)page;
+    Mixer::ChannelSettings &chs = mixer.get_channel_settings(chan);
+    switch (r) {
+    case 0: chs.volume = value; break;
+    case 1: chs.panning = value; break;
+    case 2: chs.send[Mixer::SEND_REVERB] = value; break;
+    case 3: chs.send[Mixer::SEND_DELAY] = value; break;
+    default: mixer.get_inserts(chan).set_param(r - CHANNEL_ROWS, value);
+    }
+}
+
+void MixerScreen::modify_current_setting(int increment) {
+    uint16_t value = get_value(row);
+    if (increment > 0) safe_incr(value, ui.get_step());
+    if (increment < 0) safe_decr(value, ui.get_step());
+    set_value(row, value);
+}
+
 void MixerScreen::draw() {
     // display the drum name and all parameters
     uint8_t w = display.getWidth();
@@ -340,26 +548,141 @@ void MixerScreen::draw() {
     display.drawString(0, 0, "Mixer");
     display.drawLine(0, 12, w, 12);
 
-    unsigned channel = index / SUBCHOICE_COUNT;
-    unsigned sub_choice = index % SUBCHOICE_COUNT;
-    auto chan = (Mixer::Channel)channel;
-    Mixer::ChannelSettings &chs =
-        ui.get_drummer().get_mixer().get_channel_settings(
-            chan);
-
     // add channel name to status line
-    display.drawString(64, 0, Mixer::get_channel_name(chan));
+    display.drawString(64, 0, page == Mixer::CHANNEL_MAX
+                                  ? "Master"
+                                  : Mixer::get_channel_name((Mixer::Channel)page));
+    if (page < Mixer::CHANNEL_MAX)
+        draw_part(display, page / DrumKit::VOICE_COUNT);
+
+    if (!set_mode) draw_cursor_horizonal(display, 3, 19 + (row - scroll) * 15);
+
+    // render the visible rows of the current page
+    int rc = row_count();
+    for (int r = scroll; r < rc && r < scroll + VISIBLE_ROWS; ++r) {
+        byte y = 15 + (r - scroll) * 15;
+        display.drawString(10, y, row_name(r));
+        draw_gauge(display, 64, y + 2, 60, 8, get_value(r), set_mode && r == row);
+    }
+
+    display.display();
+}
+
+NoteMapScreen::NoteMapScreen(UI &ui) : UIScreen(ui), row_count(SETTING_ROWS) {
+    for (unsigned voice = 0; voice < DrumKit::VOICE_COUNT; ++voice)
+        row_count += DrumKit::variant_count(voice);
+}
+
+void NoteMapScreen::row_voice(int r, unsigned &voice, unsigned &variant) const {
+    r -= SETTING_ROWS;
+    for (voice = 0; voice < DrumKit::VOICE_COUNT; ++voice) {
+        int count = DrumKit::variant_count(voice);
+        if (r < count) break;
+        r -= count;
+    }
+    variant = r;
+}
+
+void NoteMapScreen::onKey(KeyType key) {
+    NoteMap &note_map = ui.get_note_map();
+    int incr = 0;
+
+    switch (key) {
+    case KT_UP: incr = 1; break;
+    case KT_DOWN: incr = -1; break;
+    case KT_BACK:
+        if (set_mode || note_map.learning()) {
+            set_mode = false;
+            note_map.cancel_learn();
+            mark_dirty();
+            return;
+        }
+
+        note_map.save();
+        ui.set_screen(ST_MAIN);
+        return;
+    case KT_PRESS:
+        if (row < SETTING_ROWS) {
+            set_mode = !set_mode;
+        } else if (note_map.learning()) {
+            note_map.cancel_learn();
+        } else {
+            unsigned voice, variant;
+            row_voice(row, voice, variant);
+            note_map.learn(voice, variant, (NoteMap::LearnMode)learn_mode);
+        }
+        mark_dirty();
+        return;
+    }
+
+    if (set_mode) {
+        if (row == 0) {
+            int layout = (note_map.get_layout() + incr + NoteMap::LAYOUT_COUNT)
+                         % NoteMap::LAYOUT_COUNT;
+            note_map.set_layout((NoteMap::Layout)layout);
+        } else {
+            learn_mode = (learn_mode + incr + NoteMap::LEARN_MODE_COUNT)
+                         % NoteMap::LEARN_MODE_COUNT;
+        }
+    } else if (!note_map.learning()) {
+        row += incr;
+        if (row < 0) row = row_count - 1;
+        if (row >= row_count) row = 0;
+
+        // keep the cursor row visible
+        if (row < scroll) scroll = row;
+        if (row >= scroll + VISIBLE_ROWS) scroll = row - VISIBLE_ROWS + 1;
+    }
 
-    if (!set_mode) draw_cursor_horizonal(display, 3, 19 + sub_choice * 15);
+    // schedule redraw
+    mark_dirty();
+}
+
+void NoteMapScreen::draw() {
+    NoteMap &note_map = ui.get_note_map();
+    uint8_t w = display.getWidth();
+
+    display.clear();
+    display.setFont(ArialMT_Plain_10);
 
-    // render the settings for current channel
-    display.drawString(10, 15, "Volume");
-    draw_gauge(display, 64, 17, 60, 8, chs.volume, set_mode && sub_choice == 0);
-    display.drawString(10, 30, "Panning");
-    draw_gauge(display, 64, 32, 60, 8, chs.panning, set_mode && sub_choice == 1);
-    display.drawString(10, 45, "FX Send");
-    draw_gauge(display, 64, 47, 60, 8, chs.fx, set_mode && sub_choice == 2);
+    display.drawString(0, 0, "Notes");
+    display.drawLine(0, 12, w, 12);
 
+    // status line: learn state, or the last learned note
+    char str_val[16] = "";
+    if (note_map.learning()) {
+        strcpy(str_val, "Hit a pad");
+    } else if (note_map.get_learned_note() >= 0) {
+        strcpy(str_val, "Note ");
+        itoa(note_map.get_learned_note(), str_val + 5, 10);
+    }
+    display.drawString(64, 0, str_val);
+
+    if (!set_mode) draw_cursor_horizonal(display, 3, 19 + (row - scroll) * 15);
+
+    for (int r = scroll; r < row_count && r < scroll + VISIBLE_ROWS; ++r) {
+        byte y = 15 + (r - scroll) * 15;
+        const char *name, *value;
+
+        if (r == 0) {
+            name = "Layout";
+            value = NoteMap::layout_name(note_map.get_layout());
+        } else if (r == 1) {
+            name = "Learn";
+            value = NoteMap::learn_mode_name(learn_mode);
+        } else {
+            unsigned voice, variant;
+            row_voice(r, voice, variant);
+            name = DrumKit::name(voice);
+            value = DrumKit::variant_name(voice, variant);
+        }
+
+        display.drawString(10, y, name);
+        if (value) {
+            if (set_mode && r == row) display.drawString(56, y, ">");
+            display.drawString(64, y, value);
+        }
+    }
 
     display.display();
 }
@@ -3,18 +3,48 @@
 #include <EasyButton.h>
 #include <SH1106Spi.h>
 
+#include "encoder.h"
+#include "mixer.h"
+
 // fwds
 class Drummer;
+class NoteMap;
 class UI;
 
-using Display = SH1106Spi;
+// SH1106 that only sends what changed. The library's back buffer keeps the
+// frame last sent to the panel, just the changed column span of each 8 pixel
+// page is transferred.
+#ifndef OLEDDISPLAY_DOUBLE_BUFFER
+#error "PagedDisplay needs the OLED library's back buffer"
+#endif
 
-// all screen types
-enum ScreenType { ST_MAIN, ST_PERC, ST_MIXER, ST_PARAM };
+class PagedDisplay : public SH1106Spi {
+public:
+    PagedDisplay(byte rst, byte dc)
+        : SH1106Spi(rst, dc, /*unused*/ 0), dc(dc) {}
+
+    void display() override;
+
+    // forces the next display() call to resend the whole frame, for when
+    // the panel no longer shows the last one
+    void invalidate() { valid = false; }
 
-namespace peaks {
-class Configurable;
-} // namespace peaks
+protected:
+    void send_command(uint8_t cmd);
+
+    static constexpr unsigned WIDTH = 128;
+    static constexpr unsigned PAGES = 64 / 8;
+    // SH1106 has 132 columns of RAM, the 128 pixel panel is centered in it
+    static constexpr unsigned COLUMN_OFFSET = 2;
+
+    byte dc;
+    bool valid = false; // false until the first full frame was sent
+};
+
+using Display = PagedDisplay;
+
+// all screen types
+enum ScreenType { ST_MAIN, ST_PERC, ST_MIXER, ST_PARAM, ST_NOTES };
 
 // one ui screen. Receives button events and redraws screen
 class UIScreen {
@@ -42,7 +72,8 @@ protected:
     Display &display;
 };
 
-// main status screen. should later show midi channel, note status... currently only menu
+// main status screen. Menu on the left, live channel meters, voice activity,
+// audio engine load and underrun count around it
 class MainScreen : public UIScreen {
 public:
     struct Choice {
@@ -50,13 +81,16 @@ public:
         const char *text;
     };
 
-    static constexpr unsigned CHOICE_COUNT = 3;
+    static constexpr unsigned CHOICE_COUNT = 4;
     static const Choice choices[CHOICE_COUNT];
 
     MainScreen(UI &ui) : UIScreen(ui) {}
 
     void onKey(KeyType key) override;
 
+    // redraws whenever the audio engine publishes new meter values
+    void update() override;
+
     void draw() override;
 
     void set_index(int idx) {
@@ -65,7 +99,10 @@ public:
     }
 
 protected:
+    void draw_meters();
+
     int index = 0;
+    uint32_t status_version = 0;
 };
 
 // For now this is a percussion selection screen
@@ -95,13 +132,14 @@ public:
     void prev_percussion();
     void next_percussion();
 protected:
-    peaks::Configurable *percussion;
     const char *name; // name of the current percussion
     int perc_index = 0;
     int index = 0; // index of configurable parameter
     bool set_mode; // if true, we're setting the parameter, not selecting one
 };
 
+// mixer settings. A page per channel (fader, sends and inserts), then a page
+// for the master bus. Rows that don't fit the screen scroll
 class MixerScreen : public UIScreen {
 public:
     MixerScreen(UI &ui);
@@ -111,42 +149,81 @@ public:
     void draw() override;
 
     void set_index(int idx) {
-        index = idx;
+        page = idx;
+        row = scroll = 0;
         mark_dirty();
     }
 
 protected:
     void modify_current_setting(int increment);
 
-    // this is volume+panning. If other option gets added we have to increase this
-    static constexpr int SUBCHOICE_COUNT = 3;
+    // rows of the current page
+    int row_count() const;
+    const char *row_name(int r) const;
+    uint16_t get_value(int r) const;
+    void set_value(int r, uint16_t value);
+
+    // channel rows before the insert parameters: volume, panning, sends
+    static constexpr int CHANNEL_ROWS = 2 + Mixer::SEND_MAX;
+    // effect returns and settings, then the dynamics
+    static constexpr int MASTER_ROWS = 8;
+    static constexpr int VISIBLE_ROWS = 3;
+
+    int page_count;
+    int page = 0;
+    int row = 0;
+    int scroll = 0; // first visible row
+    bool set_mode = false;
+};
 
-    int idx_max;
-    int index = 0;
+// MIDI note map. Layout selection and learn mode: pick a voice, then hit
+// the pad that should play it
+class NoteMapScreen : public UIScreen {
+public:
+    NoteMapScreen(UI &ui);
+
+    void onKey(KeyType key) override;
+
+    void draw() override;
+
+protected:
+    // voice and variant of a learn row
+    void row_voice(int r, unsigned &voice, unsigned &variant) const;
+
+    // layout and learn mode, then a row per voice variant
+    static constexpr int SETTING_ROWS = 2;
+    static constexpr int VISIBLE_ROWS = 3;
+
+    int row_count;
+    int row = 0;
+    int scroll = 0; // first visible row
+    int learn_mode = 0;
     bool set_mode = false;
 };
 
 class UI {
 public:
-    UI(Drummer &drummer, byte key, byte s1, byte s2, byte back, byte rst, byte dc)
-        : drummer(drummer), display(rst, dc, /*unused*/ 0), key(key), s1(s1),
-          s2(s2), back(back), scrMain(*this), scrPerc(*this), scrParam(*this),
-          scrMixer(*this)
+    UI(Drummer &drummer, NoteMap &note_map, byte key, byte s1, byte s2,
+       byte back, byte rst, byte dc)
+        : drummer(drummer), note_map(note_map), display(rst, dc), key(key),
+          encoder(s1, s2), back(back), scrMain(*this), scrPerc(*this),
+          scrParam(*this), scrMixer(*this), scrNotes(*this)
     {
         active_screen = &scrMain;
     }
 
     void init() {
         display.init();
+        // the flip remaps the columns, what the panel shows is stale
         display.flipScreenVertically();
+        display.invalidate();
         display.setContrast(255);
         display.clear();
 
         intro_screen();
 
         key.begin();
-        s1.begin();
-        s2.begin();
+        encoder.begin();
         back.begin();
 
         // TODO: Move the update loop to the other core via xTaskCreatePinnedToCore
@@ -159,14 +236,13 @@ public:
 
     void update() {
         key.read();
-        s1.read();
-        s2.read();
         back.read();
 
-        // update the position based on latest changes to buttons
-        if (s1.wasPressed()) {
-            active_screen->onKey(s2.isPressed() ? UIScreen::KT_UP : UIScreen::KT_DOWN);
-        }
+        // input is handled right away, the screens only mark themselves dirty.
+        // Everything that changed between two frames gets a single redraw.
+        int detents = encoder.read();
+        for (; detents > 0; --detents) active_screen->onKey(UIScreen::KT_UP);
+        for (; detents < 0; ++detents) active_screen->onKey(UIScreen::KT_DOWN);
 
         if (key.wasPressed()) {
             active_screen->onKey(UIScreen::KT_PRESS);
@@ -176,6 +252,10 @@ public:
             active_screen->onKey(UIScreen::KT_BACK);
         }
 
+        unsigned long now = millis();
+        if (now - last_frame < frame_interval()) return;
+        last_frame = now;
+
         active_screen->update();
     }
 
@@ -191,6 +271,7 @@ public:
         case ST_PERC:  return &scrPerc;
         case ST_PARAM: return &scrParam;
         case ST_MIXER: return &scrMixer;
+        case ST_NOTES: return &scrNotes;
         default: return nullptr;
         }
     }
@@ -199,11 +280,26 @@ public:
         return drummer;
     }
 
+    NoteMap &get_note_map() {
+        return note_map;
+    }
+
     Display &get_display() {
         return display;
     }
 
+    // value change per encoder detent, grows with the turning speed
+    uint16_t get_step() const;
+
 protected:
+    // ~30 fps when the audio engine has headroom
+    static constexpr unsigned FRAME_INTERVAL_MS     = 33;
+    // slowest refresh we back off to under heavy audio load
+    static constexpr unsigned FRAME_INTERVAL_MAX_MS = 250;
+
+    // current redraw interval, adapted to the audio engine load
+    unsigned frame_interval() const;
+
     void intro_screen() {
         // WHATEVER, this is just a placeholder!
         uint8_t w = display.getWidth();
@@ -224,17 +320,20 @@ protected:
     }
 
     Drummer &drummer;
+    NoteMap &note_map;
     Display display;
 
     EasyButton key;
-    EasyButton s1;
-    EasyButton s2;
+    RotaryEncoder encoder;
     EasyButton back;
 
     MainScreen scrMain;
     PercussionScreen scrPerc;
     ParamScreen scrParam;
     MixerScreen scrMixer;
+    NoteMapScreen scrNotes;
 
     UIScreen *active_screen;
+
+    unsigned long last_frame = 0;
 };
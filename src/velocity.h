@@ -0,0 +1,30 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Velocity response of a voice. The shape bends the curve from logarithmic
+// (0, soft hits come out louder) over linear (32768) to exponential (65535,
+// soft hits fall away). The depth is how far the softest hit drops below a
+// full one, 0 plays every hit at full level.
+struct VelocityCurve {
+    static constexpr uint16_t DEFAULT_SHAPE = 32768;
+    static constexpr uint16_t DEFAULT_DEPTH = 65535;
+
+    uint16_t shape = DEFAULT_SHAPE;
+    uint16_t depth = DEFAULT_DEPTH;
+
+    // MIDI velocity to a level, 65535 is full
+    uint16_t map(byte velocity) const {
+        uint32_t x = velocity >= 127 ? 65535 : velocity * 65535 / 127;
+        uint32_t expo = x * x >> 16;
+        uint32_t loga = 65535 - ((65535 - x) * (65535 - x) >> 16);
+
+        uint32_t y;
+        if (shape < 32768)
+            y = loga - ((loga - x) * shape >> 15);
+        else
+            y = x - ((x - expo) * (shape - 32768) >> 15);
+
+        return 65535 - ((65535 - y) * depth >> 16);
+    }
+};
@@ -0,0 +1,416 @@
+// Golden output test. Renders every voice of the kit over a grid of
+// parameters and velocities, and the whole drummer (voices, mixer, inserts,
+// send effects and master dynamics) over a few fixed patterns, then
+// compares each case with its reference buffer in ref/.
+//
+// Voice cases are integer math and have to be bit-exact. Drummer cases go
+// through floating point coefficients and pass at MIN_SNR_DRUMMER, so that
+// another compiler or libm doesn't fail them. A failing case reports its
+// SNR and the first sample that differs.
+//
+//   make             builds and runs the test
+//   make SNR=60      passes every case at 60dB or better, for a change that
+//                    deliberately isn't bit-exact
+//   make update      stores the current output as the new reference
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <new>
+#include <string>
+#include <vector>
+
+#include "drummer.h"
+
+namespace host {
+extern size_t i2s_room;
+extern std::vector<uint8_t> i2s_written;
+}
+
+namespace {
+
+// voice cases: the defaults at each velocity, then every parameter at both
+// ends of its range
+constexpr unsigned DEFAULT_SAMPLES = 4096; // ~100ms
+constexpr unsigned PARAM_SAMPLES   = 2048;
+const byte default_velocities[] = {40, 100, 127};
+const uint16_t param_values[] = {0, 65535};
+constexpr byte PARAM_VELOCITY = 100;
+
+// drummer cases, ~200ms each
+constexpr unsigned DRUMMER_BLOCKS = 256;
+constexpr float MIN_SNR_DRUMMER = 100.0f;
+
+struct Case {
+    std::string name;
+    unsigned channels;     // interleaved
+    unsigned sample_bytes; // per sample in the reference file, 2 or 4
+    float min_snr;         // dB, INFINITY for bit-exact
+    std::vector<int32_t> samples;
+};
+
+std::vector<Case> cases;
+
+// reference file of the case: the name in lower case, dashes between words
+std::string file_name(const std::string &name) {
+    std::string file;
+    for (char c : name) {
+        if (isalnum((unsigned char)c))
+            file += tolower((unsigned char)c);
+        else if (!file.empty() && file.back() != '-')
+            file += '-';
+    }
+    return file + ".raw";
+}
+
+// --- voice cases ---
+
+template<typename Voice>
+std::vector<int32_t> render_voice(unsigned idx, unsigned variant, int param,
+                                  uint16_t value, byte velocity,
+                                  unsigned samples) {
+    // a fresh voice per case, zeroed so that state its Init leaves alone is
+    // the same in every run and no case depends on the one before
+    void *mem = calloc(1, sizeof(Voice));
+    Voice *voice = new (mem) Voice;
+
+    Drummer::ConfigureVoice configure;
+    configure(*voice, idx);
+    if (param >= 0) voice->set_param(param, value);
+    voice->set_velocity(VelocityCurve().map(velocity),
+                        velocity > ACCENT_THRESHOLD);
+    voice->set_variant(variant);
+
+    std::vector<int32_t> out;
+    int16_t block[Mixer::BLOCK_SIZE];
+    for (unsigned s = 0; s < samples; s += Mixer::BLOCK_SIZE) {
+        voice->Render(s ? peaks::CONTROL_GATE : peaks::CONTROL_GATE_RISING,
+                      block, Mixer::BLOCK_SIZE);
+        out.insert(out.end(), block, block + sizeof(block) / sizeof(*block));
+    }
+
+    voice->~Voice();
+    free(mem);
+    return out;
+}
+
+struct AddVoiceCases {
+    template<typename Voice>
+    void operator()(Voice &, unsigned idx) {
+        for (unsigned variant = 0; variant < Voice::VARIANT_COUNT; ++variant) {
+            std::string base = std::string("voice ") + Voice::name();
+            if (Voice::variant_name(variant))
+                base += std::string(" ") + Voice::variant_name(variant);
+
+            for (byte velocity : default_velocities) {
+                add(base + " vel " + std::to_string(velocity),
+                    render_voice<Voice>(idx, variant, -1, 0, velocity,
+                                        DEFAULT_SAMPLES));
+            }
+
+            for (unsigned param = 0; param < Voice::PARAM_COUNT; ++param) {
+                for (uint16_t value : param_values) {
+                    add(base + " " + Voice::param_name(param) + " "
+                            + std::to_string(value),
+                        render_voice<Voice>(idx, variant, param, value,
+                                            PARAM_VELOCITY, PARAM_SAMPLES));
+                }
+            }
+        }
+    }
+
+    void add(const std::string &name, std::vector<int32_t> samples) {
+        cases.push_back({name, 1, 2, INFINITY, std::move(samples)});
+    }
+};
+
+// --- drummer cases ---
+
+struct Hit {
+    unsigned block;
+    unsigned voice;
+    byte velocity;
+    unsigned variant;
+};
+
+constexpr unsigned BASS_DRUM = DrumKit::index_of<peaks::BassDrum>();
+constexpr unsigned KICK_DRUM = DrumKit::index_of<peaks::KickDrum>();
+constexpr unsigned SNARE     = DrumKit::index_of<peaks::SnareDrum>();
+constexpr unsigned HIHAT     = DrumKit::index_of<peaks::HighHat>();
+constexpr unsigned FM        = DrumKit::index_of<peaks::FmDrum>();
+constexpr unsigned CLAP      = DrumKit::index_of<peaks::Clap>();
+
+constexpr unsigned OPEN = peaks::HighHat::VARIANT_OPEN;
+
+// a bar of every voice. Voices left out of the kit are skipped by the
+// drummer
+const Hit pattern[] = {
+    {0,   BASS_DRUM, 127, 0},
+    {0,   HIHAT,     90,  0},
+    {24,  HIHAT,     60,  0},
+    {32,  SNARE,     127, 0},
+    {48,  HIHAT,     90,  OPEN},
+    {56,  FM,        100, 0},
+    {64,  KICK_DRUM, 127, 0},
+    {64,  HIHAT,     110, 0},
+    {80,  CLAP,      120, 0},
+    {96,  FM,        70,  0},
+    {112, BASS_DRUM, 50,  0},
+    {112, HIHAT,     127, OPEN},
+    {120, HIHAT,     80,  0},
+};
+
+void set_param_named(Drummer &d, unsigned voice, const char *name,
+                     uint16_t value) {
+    for (unsigned p = 0; p < d.param_count(voice); ++p)
+        if (!strcmp(d.param_name(voice, p), name)) d.set_param(voice, p, value);
+}
+
+Mixer::Channel channel(unsigned voice) {
+    return (Mixer::Channel)voice;
+}
+
+// renders the pattern through a drummer the setup function configured
+template<typename Setup>
+void add_drummer_case(const char *name, Setup setup,
+                      bool locks = false) {
+    // zeroed for the same reason as the voices
+    void *mem = calloc(1, sizeof(Drummer));
+    Drummer *d = new (mem) Drummer;
+    d->init();
+    setup(*d);
+
+    host::i2s_written.clear();
+    for (unsigned block = 0; block < DRUMMER_BLOCKS; ++block) {
+        for (const Hit &hit : pattern) {
+            if (hit.block != block) continue;
+
+            Drummer::TriggerEvent ev = {};
+            ev.voice = hit.voice;
+            ev.variant = hit.variant;
+            ev.velocity = hit.velocity;
+            if (locks && hit.voice == SNARE) {
+                // the first two parameters, for this hit only
+                ev.lock_count = 2;
+                ev.locks[0] = {0, 60000};
+                ev.locks[1] = {1, 5000};
+            }
+            d->trigger(ev);
+        }
+
+        // one block per call, the drummer renders the next one ahead
+        host::i2s_room = sizeof(i2s_sample_t) * 2 * Mixer::BLOCK_SIZE;
+        d->update();
+    }
+
+    std::vector<int32_t> samples;
+    const std::vector<uint8_t> &bytes = host::i2s_written;
+    for (size_t i = 0; i + sizeof(i2s_sample_t) <= bytes.size();
+         i += sizeof(i2s_sample_t)) {
+        i2s_sample_t s;
+        memcpy(&s, &bytes[i], sizeof(s));
+        samples.push_back(s);
+    }
+
+    cases.push_back({std::string("drummer ") + name, 2, sizeof(i2s_sample_t),
+                     MIN_SNR_DRUMMER, std::move(samples)});
+
+    d->~Drummer();
+    free(mem);
+}
+
+void add_drummer_cases() {
+    add_drummer_case("defaults", [](Drummer &) {});
+
+    add_drummer_case("sends", [](Drummer &d) {
+        Mixer &mixer = d.get_mixer();
+        if (SNARE < Mixer::CHANNEL_MAX)
+            mixer.get_channel_settings(channel(SNARE)).send[Mixer::SEND_REVERB] = 40000;
+        if (CLAP < Mixer::CHANNEL_MAX)
+            mixer.get_channel_settings(channel(CLAP)).send[Mixer::SEND_REVERB] = 50000;
+        if (HIHAT < Mixer::CHANNEL_MAX) {
+            mixer.get_channel_settings(channel(HIHAT)).send[Mixer::SEND_DELAY] = 30000;
+            mixer.get_channel_settings(channel(HIHAT)).panning = 12000;
+        }
+        if (FM < Mixer::CHANNEL_MAX)
+            mixer.get_channel_settings(channel(FM)).panning = 56000;
+
+        Mixer::MasterSettings &master = mixer.get_master_settings();
+        master.delay_time = 20000;
+        master.delay_feedback = 40000;
+    });
+
+    add_drummer_case("mono reverb", [](Drummer &d) {
+        Mixer &mixer = d.get_mixer();
+        for (unsigned chan = 0; chan < Mixer::CHANNEL_MAX; ++chan)
+            mixer.get_channel_settings(channel(chan)).send[Mixer::SEND_REVERB] = 30000;
+        mixer.get_master_settings().reverb_width = 0;
+    });
+
+    add_drummer_case("dynamics", [](Drummer &d) {
+        Mixer &mixer = d.get_mixer();
+        for (unsigned chan = 0; chan < Mixer::CHANNEL_MAX; ++chan)
+            mixer.set_volume(channel(chan), Mixer::VOL_MAX);
+
+        Mixer::MasterSettings &master = mixer.get_master_settings();
+        master.comp_threshold = 50000;
+        master.comp_ratio = 40000;
+        master.ceiling = 40000;
+    });
+
+    add_drummer_case("inserts", [](Drummer &d) {
+        Mixer &mixer = d.get_mixer();
+        for (unsigned chan = 0; chan < Mixer::CHANNEL_MAX; ++chan) {
+            Mixer::ChannelInserts &inserts = mixer.get_inserts(channel(chan));
+            // EQ boost, drive, bit crush and sample hold, see inserts.h
+            for (unsigned p = 0; p < Mixer::ChannelInserts::PARAM_COUNT; ++p)
+                inserts.set_param(p, 20000 + 9000 * ((chan + p) % 5));
+        }
+    });
+
+    add_drummer_case("voice settings", [](Drummer &d) {
+        // velocity curves, choke groups and p-locks
+        for (unsigned voice = 0; voice < DrumKit::VOICE_COUNT; ++voice) {
+            set_param_named(d, voice, "Vel. Curve", 10000 * voice);
+            set_param_named(d, voice, "Vel. Depth", 40000);
+        }
+        set_param_named(d, HIHAT, "Choke Grp", 30000);
+        set_param_named(d, FM, "Choke Grp", 30000);
+    }, true);
+}
+
+// --- comparison ---
+
+bool read_reference(const std::string &path, const Case &c,
+                    std::vector<int32_t> &ref) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+
+    ref.clear();
+    uint8_t buf[4];
+    while (fread(buf, c.sample_bytes, 1, f) == 1) {
+        // little endian, sign extended
+        if (c.sample_bytes == 2)
+            ref.push_back(int16_t(buf[0] | buf[1] << 8));
+        else
+            ref.push_back(int32_t(uint32_t(buf[0]) | uint32_t(buf[1]) << 8
+                                  | uint32_t(buf[2]) << 16
+                                  | uint32_t(buf[3]) << 24));
+    }
+    fclose(f);
+    return true;
+}
+
+bool write_reference(const std::string &path, const Case &c) {
+    FILE *f = fopen(path.c_str(), "wb");
+    if (!f) return false;
+
+    for (int32_t s : c.samples) {
+        uint8_t buf[4] = {uint8_t(s), uint8_t(s >> 8), uint8_t(s >> 16),
+                          uint8_t(s >> 24)};
+        fwrite(buf, c.sample_bytes, 1, f);
+    }
+    return fclose(f) == 0;
+}
+
+// prints the result of the case, true if it passed
+bool compare(const Case &c, const std::vector<int32_t> &ref, float min_snr) {
+    const char *name = c.name.c_str();
+
+    if (ref.size() != c.samples.size()) {
+        printf("FAIL %-40s %u samples, expected %u\n", name,
+               (unsigned)c.samples.size(), (unsigned)ref.size());
+        return false;
+    }
+
+    size_t first = ref.size();
+    double signal = 0, noise = 0;
+    for (size_t i = 0; i < ref.size(); ++i) {
+        double diff = double(c.samples[i]) - ref[i];
+        signal += double(ref[i]) * ref[i];
+        noise += diff * diff;
+        if (diff != 0 && first == ref.size()) first = i;
+    }
+
+    if (first == ref.size()) {
+        printf("ok   %-40s bit-exact\n", name);
+        return true;
+    }
+
+    double snr = signal > 0 ? 10 * log10(signal / noise) : -INFINITY;
+    bool pass = snr >= min_snr;
+
+    char limit[16] = "bit-exact";
+    if (isfinite(min_snr)) snprintf(limit, sizeof(limit), "%.0f dB", min_snr);
+
+    size_t frame = first / c.channels;
+    const char *side = c.channels == 2 ? (first % 2 ? " R" : " L") : "";
+    printf("%s %-40s SNR %.1f dB (min %s), first difference at sample %u%s"
+           " (%.1f ms): %d, expected %d\n",
+           pass ? "ok  " : "FAIL", name, snr, limit, (unsigned)frame, side,
+           1000.0 * frame / SAMPLE_RATE, (int)c.samples[first],
+           (int)ref[first]);
+    return pass;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    bool update = false;
+    float snr_override = NAN;
+    std::string ref_dir = "ref";
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--update")
+            update = true;
+        else if (arg == "--snr" && i + 1 < argc)
+            snr_override = atof(argv[++i]);
+        else if (arg[0] != '-')
+            ref_dir = arg;
+        else {
+            fprintf(stderr, "usage: %s [--update] [--snr dB] [ref dir]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    static DrumKit kit;
+    AddVoiceCases add_voices;
+    kit.visit(add_voices);
+    add_drummer_cases();
+
+    unsigned failed = 0;
+    for (const Case &c : cases) {
+        std::string path = ref_dir + "/" + file_name(c.name);
+
+        if (update) {
+            if (!write_reference(path, c)) {
+                printf("FAIL %-40s can't write %s\n", c.name.c_str(),
+                       path.c_str());
+                ++failed;
+            }
+            continue;
+        }
+
+        std::vector<int32_t> ref;
+        if (!read_reference(path, c, ref)) {
+            printf("FAIL %-40s no reference %s, see make update\n",
+                   c.name.c_str(), path.c_str());
+            ++failed;
+            continue;
+        }
+
+        float min_snr = isnan(snr_override) ? c.min_snr : snr_override;
+        if (!compare(c, ref, min_snr)) ++failed;
+    }
+
+    if (update)
+        printf("%u references written to %s\n",
+               (unsigned)cases.size() - failed, ref_dir.c_str());
+    else
+        printf("%u of %u cases passed\n", (unsigned)cases.size() - failed,
+               (unsigned)cases.size());
+    return failed ? 1 : 0;
+}
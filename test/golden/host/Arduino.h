@@ -0,0 +1,35 @@
+#pragma once
+
+// The parts of the Arduino ESP32 core the DSP code uses, for building it on
+// the host. Placement attributes are dropped, timing reads zero.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+typedef uint8_t byte;
+typedef uint32_t TickType_t;
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+#define PI 3.1415926535897932384626433832795
+
+unsigned long micros();
+unsigned long millis();
+
+struct EspClass {
+    uint32_t getCycleCount() { return 0; }
+    uint32_t getCpuFreqMHz() { return 240; }
+};
+extern EspClass ESP;
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+};
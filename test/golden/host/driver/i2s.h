@@ -0,0 +1,43 @@
+#pragma once
+
+// I2S driver API of ESP-IDF, as far as the drummer uses it. Writes go to
+// host::i2s_written, see host.cc
+
+#include <Arduino.h>
+
+typedef int i2s_port_t;
+typedef int i2s_mode_t;
+typedef int i2s_comm_format_t;
+typedef int i2s_bits_per_sample_t;
+typedef int i2s_channel_fmt_t;
+
+enum {
+    I2S_MODE_MASTER = 1,
+    I2S_MODE_TX = 4,
+    I2S_CHANNEL_FMT_RIGHT_LEFT = 0,
+    I2S_COMM_FORMAT_I2S = 1,
+    I2S_COMM_FORMAT_I2S_LSB = 4,
+    ESP_INTR_FLAG_LEVEL1 = 2,
+};
+
+struct i2s_config_t {
+    i2s_mode_t mode;
+    int sample_rate;
+    i2s_bits_per_sample_t bits_per_sample;
+    i2s_channel_fmt_t channel_format;
+    i2s_comm_format_t communication_format;
+    int intr_alloc_flags;
+    int dma_buf_count;
+    int dma_buf_len;
+};
+
+struct i2s_pin_config_t {
+    int bck_io_num;
+    int ws_io_num;
+    int data_out_num;
+    int data_in_num;
+};
+
+int i2s_driver_install(i2s_port_t, const i2s_config_t *, int, void *);
+int i2s_set_pin(i2s_port_t, const i2s_pin_config_t *);
+int i2s_write_bytes(i2s_port_t, const char *src, size_t size, TickType_t);